@@ -5,32 +5,77 @@
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/hash.hpp>
+#include <glm/gtc/packing.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <fstream>
+#include <filesystem>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <optional>
 #include <set>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <unordered_map>
 
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 const int WIDTH = 800;
 const int HEIGHT = 600;
 
 const std::string MODEL_PATH = "models/chalet.obj";
+const std::string MODEL_CACHE_PATH = "models/chalet.obj.meshcache";
 const std::string TEXTURE_PATH = "textures/chalet.jpg";
+//pre-baked containers in order of preference, the first one the device can sample is used instead of TEXTURE_PATH
+const std::vector<std::string> COMPRESSED_TEXTURE_PATHS = {
+	"textures/chalet.bc7.ktx2",
+	"textures/chalet.astc.ktx2",
+	"textures/chalet.etc2.ktx2",
+	"textures/chalet.dds"
+};
+const std::string PIPELINE_CACHE_PATH = "pipeline_cache.bin";
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+const uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+//upper bound on the bindless texture array, lowered to whatever the device allows
+const uint32_t BINDLESS_TEXTURE_CAPACITY = 1024;
 
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
@@ -71,6 +116,8 @@ VKAPI_ATTR void VKAPI_CALL vkDestroyDebugUtilsMessengerEXT(
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	//a dedicated DMA family when the device has one, otherwise the graphics family
+	std::optional<uint32_t> transferFamily;
 
 	bool isComplete() {
 		return graphicsFamily.has_value() && presentFamily.has_value();
@@ -83,1205 +130,6210 @@ struct SwapchainSupportDetails {
 	std::vector<vk::PresentModeKHR> presentModes;
 };
 
+//what the vertex buffer holds, the mesh itself is always loaded, optimised and cached as Vertex
+enum class VertexFormat {
+	//32-bit floats, exactly what loadModel() produces
+	eFull,
+	//half float positions in [-1, 1] over the bounding box, half float texcoords in [0, 1] over their range
+	eHalf,
+	//16-bit normalised positions and texcoords, both in [0, 1] over their ranges
+	eUnorm16
+};
+
+//w is only padding, three component 16-bit formats are rarely supported for vertex buffers
+struct PackedVertex {
+	uint16_t pos[4];
+	uint16_t texCoord[2];
+};
+
 struct Vertex {
 	glm::vec3 pos;
-	glm::vec3 color;
 	glm::vec2 texCoord;
 
-	static vk::VertexInputBindingDescription getBindingDescription() {
+	static uint32_t getStride(VertexFormat format) {
+		return format == VertexFormat::eFull ? sizeof(Vertex) : sizeof(PackedVertex);
+	}
+
+	static vk::VertexInputBindingDescription getBindingDescription(VertexFormat format) {
 		vk::VertexInputBindingDescription bindingDescription = {};
 
 		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
+		bindingDescription.stride = getStride(format);
 		bindingDescription.inputRate = vk::VertexInputRate::eVertex;
 
 		return bindingDescription;
 	}
 
-	static std::array<vk::VertexInputAttributeDescription, 3> getAttributeDescriptions() {
-		std::array<vk::VertexInputAttributeDescription, 3> attributeDescriptions = {};
+	//per instance transforms come from a second binding
+	static vk::VertexInputBindingDescription getInstanceBindingDescription() {
+		vk::VertexInputBindingDescription bindingDescription = {};
+
+		bindingDescription.binding = 1;
+		bindingDescription.stride = sizeof(glm::mat4);
+		bindingDescription.inputRate = vk::VertexInputRate::eInstance;
+
+		return bindingDescription;
+	}
+
+	//a mat4 attribute takes up one location per column
+	static std::array<vk::VertexInputAttributeDescription, 4> getInstanceAttributeDescriptions() {
+		std::array<vk::VertexInputAttributeDescription, 4> attributeDescriptions = {};
+
+		for (uint32_t column = 0; column < 4; ++column) {
+			attributeDescriptions[column].binding = 1;
+			attributeDescriptions[column].location = 2 + column;
+			attributeDescriptions[column].format = vk::Format::eR32G32B32A32Sfloat;
+			attributeDescriptions[column].offset = column * sizeof(glm::vec4);
+		}
+
+		return attributeDescriptions;
+	}
+
+	//the packed formats are normalised or half floats, so the shader sees floats either way and only dequantises through the UBO
+	static std::array<vk::VertexInputAttributeDescription, 2> getAttributeDescriptions(VertexFormat format) {
+		std::array<vk::VertexInputAttributeDescription, 2> attributeDescriptions = {};
 
 		attributeDescriptions[0].binding = 0;
 		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = vk::Format::eR32G32B32Sfloat;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
 		attributeDescriptions[1].binding = 0;
 		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = vk::Format::eR32G32B32Sfloat;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
 
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = vk::Format::eR32G32Sfloat;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+		switch (format) {
+		case VertexFormat::eFull:
+			attributeDescriptions[0].format = vk::Format::eR32G32B32Sfloat;
+			attributeDescriptions[0].offset = offsetof(Vertex, pos);
+			attributeDescriptions[1].format = vk::Format::eR32G32Sfloat;
+			attributeDescriptions[1].offset = offsetof(Vertex, texCoord);
+			break;
+		case VertexFormat::eHalf:
+			attributeDescriptions[0].format = vk::Format::eR16G16B16A16Sfloat;
+			attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+			attributeDescriptions[1].format = vk::Format::eR16G16Sfloat;
+			attributeDescriptions[1].offset = offsetof(PackedVertex, texCoord);
+			break;
+		case VertexFormat::eUnorm16:
+			attributeDescriptions[0].format = vk::Format::eR16G16B16A16Unorm;
+			attributeDescriptions[0].offset = offsetof(PackedVertex, pos);
+			attributeDescriptions[1].format = vk::Format::eR16G16Unorm;
+			attributeDescriptions[1].offset = offsetof(PackedVertex, texCoord);
+			break;
+		}
 
 		return attributeDescriptions;
 	}
 
 	bool operator==(const Vertex& other) const {
-		return pos == other.pos && color == other.color && texCoord == other.texCoord;
+		return pos == other.pos && texCoord == other.texCoord;
 	}
 };
 
-namespace std {
-	template<> struct hash<Vertex> {
-		size_t operator()(Vertex const& vertex) const {
-			return ((hash<glm::vec3>()(vertex.pos) ^ (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^ (hash<glm::vec2>()(vertex.texCoord) << 1);
-		}
-	};
+//vertices are hashed and compared as raw bytes, which is only exact while Vertex has no padding
+static_assert(sizeof(Vertex) % sizeof(uint32_t) == 0, "Vertex must be made of whole 32-bit words");
+
+//-0.0f and 0.0f are the same position but not the same bytes, so they are turned into 0.0f before hashing
+Vertex canonicalVertex(const Vertex& vertex) {
+	Vertex canonical = vertex;
+	for (float* value : {&canonical.pos.x, &canonical.pos.y, &canonical.pos.z, &canonical.texCoord.x, &canonical.texCoord.y}) {
+		if (*value == 0.0f)
+			*value = 0.0f;
+	}
+	return canonical;
 }
 
-struct UniformBufferObject {
-	glm::mat4 model;
-	glm::mat4 view;
-	glm::mat4 proj;
-};
+uint64_t hashVertex(const Vertex& vertex) {
+	const uint32_t wordCount = sizeof(Vertex) / sizeof(uint32_t);
+	uint32_t words[wordCount];
+	memcpy(words, &vertex, sizeof(Vertex));
 
-class HelloTriangleApplication {
+	uint64_t hash = 0x9E3779B97F4A7C15ull;
+	for (uint32_t word : words) {
+		hash ^= word;
+		hash *= 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 32;
+	}
+
+	//murmur3 finaliser, so the low bits used for the slot index depend on every input bit
+	hash ^= hash >> 33;
+	hash *= 0xC4CEB9FE1A85EC53ull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+//open addressing with linear probing, slots hold an index into the caller's vertex array plus some hash bits to skip most compares
+class VertexDeduplicator {
 public:
-	void run() {
-		initWindow();
-		initVulkan();
-		mainLoop();
-		cleanup();
+	explicit VertexDeduplicator(size_t expectedVertices) {
+		size_t capacity = 16;
+		while (capacity < expectedVertices * 2)
+			capacity *= 2;
+		slots.assign(capacity, Slot{EMPTY, 0});
+	}
+
+	//returns the index of vertex in vertices, appending it first if it isn't there yet
+	uint32_t insert(const Vertex& original, std::vector<Vertex>& vertices) {
+		Vertex vertex = canonicalVertex(original);
+		uint64_t hash = hashVertex(vertex);
+		uint32_t tag = static_cast<uint32_t>(hash >> 32);
+		size_t mask = slots.size() - 1;
+
+		for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask) {
+			Slot& slot = slots[i];
+			if (slot.index == EMPTY) {
+				uint32_t index = static_cast<uint32_t>(vertices.size());
+				vertices.push_back(vertex);
+				slot = Slot{index, tag};
+
+				if (++count * 2 > slots.size())
+					grow(vertices);
+				return index;
+			}
+
+			if (slot.tag == tag && memcmp(&vertices[slot.index], &vertex, sizeof(Vertex)) == 0)
+				return slot.index;
+		}
 	}
 
 private:
-	SDL_Window* window = nullptr;
-	SDL_Event event;
-	bool quitting = false;
+	static const uint32_t EMPTY = UINT32_MAX;
 
-	vk::UniqueInstance instance;
-	vk::UniqueDebugUtilsMessengerEXT debugMessenger;
-	vk::UniqueSurfaceKHR surface;
+	struct Slot {
+		uint32_t index;
+		uint32_t tag;
+	};
 
-	vk::PhysicalDevice physicalDevice;
-	vk::SampleCountFlagBits msaaSamples = vk::SampleCountFlagBits::e1;
-	vk::UniqueDevice device;
+	std::vector<Slot> slots;
+	size_t count = 0;
 
-	vk::Queue graphicsQueue;
-	vk::Queue presentQueue;
+	void grow(const std::vector<Vertex>& vertices) {
+		std::vector<Slot> oldSlots(slots.size() * 2, Slot{EMPTY, 0});
+		oldSlots.swap(slots);
 
-	vk::UniqueSwapchainKHR swapchain;
-	std::vector<vk::Image> swapchainImages;
-	vk::Format swapchainImageFormat;
-	vk::Extent2D swapchainExtent;
-	std::vector<vk::UniqueImageView> swapchainImageViews;
-	std::vector<vk::UniqueFramebuffer> swapchainFramebuffers;
+		size_t mask = slots.size() - 1;
+		for (const Slot& slot : oldSlots) {
+			if (slot.index == EMPTY)
+				continue;
 
-	vk::UniqueRenderPass renderPass;
-	vk::UniqueDescriptorSetLayout descriptorSetLayout;
-	vk::UniquePipelineLayout pipelineLayout;
-	std::vector<vk::UniquePipeline> graphicsPipelines;
+			size_t i = static_cast<size_t>(hashVertex(vertices[slot.index])) & mask;
+			while (slots[i].index != EMPTY)
+				i = (i + 1) & mask;
+			slots[i] = slot;
+		}
+	}
+};
 
-	vk::UniqueCommandPool commandPool;
+//everything that is the same for every vertex of the frame, the per object transforms live in the instance buffer
+struct UniformBufferObject {
+	//multiplied once per frame on the cpu instead of once per vertex
+	glm::mat4 viewProj;
+	//xyz scale and offset that take the vertex buffer's positions back to model space
+	glm::vec4 positionScale;
+	glm::vec4 positionOffset;
+	//xy scale and zw offset that take the vertex buffer's texcoords back to the mesh's
+	glm::vec4 texCoordTransform;
+};
 
-	vk::UniqueImage colorImage;
-	vk::UniqueDeviceMemory colorImageMemory;
-	vk::UniqueImageView colorImageView;
+//push constants of shaders/cull.comp, which runs once with pass 0 and once with pass 1
+struct CullParameters {
+	glm::vec4 frustumPlanes[6];
+	uint32_t instanceCount;
+	uint32_t submeshCount;
+	float radius;
+	float lodDistance;
+	uint32_t lodCount;
+	uint32_t pass;
+	uint32_t compact;
+};
 
-	vk::UniqueImage depthImage;
-	vk::UniqueDeviceMemory depthImageMemory;
-	vk::UniqueImageView depthImageView;
+//a GLSL source and the SPIR-V that shaders/compile.bat builds from it, which is what gets loaded without --hot-reload
+struct ShaderSource {
+	const char* sourcePath;
+	const char* prebuiltPath;
+};
 
-	uint32_t mipLevels;
-	vk::UniqueImage textureImage;
-	vk::UniqueDeviceMemory textureImageMemory;
-	vk::UniqueImageView textureImageView;
-	vk::UniqueSampler textureSampler;
+const ShaderSource VERTEX_SHADER = {"shaders/shader.vert", "shaders/vert.spv"};
+const ShaderSource FRAGMENT_SHADER = {"shaders/shader.frag", "shaders/frag.spv"};
+const ShaderSource BINDLESS_FRAGMENT_SHADER = {"shaders/shader_bindless.frag", "shaders/frag_bindless.spv"};
+const ShaderSource CULL_SHADER = {"shaders/cull.comp", "shaders/cull.spv"};
+
+//compiled SPIR-V named after a hash of its source, so going back to an earlier version of a shader is free too
+const std::string SHADER_CACHE_DIRECTORY = "shader_cache";
+//from the Vulkan SDK, found through PATH
+const std::string SHADER_COMPILER = "glslc";
+//how often --hot-reload looks at the sources' timestamps
+const double SHADER_POLL_INTERVAL_MS = 250.0;
+
+//everything a graphics pipeline is specialised on, graphics pipelines are looked up by its hash.
+//only 32-bit fields so that there is no padding to throw the hash off
+struct PipelineVariant {
+	VertexFormat vertexFormat;
+	uint32_t sampleCount;
+	uint32_t bindless;
+	//the fragment shaders' specialization constants, in constant_id order
+	uint32_t textured;
+	uint32_t alphaTest;
+};
 
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
-	vk::UniqueBuffer vertexBuffer;
-	vk::UniqueDeviceMemory vertexBufferMemory;
-	vk::UniqueBuffer indexBuffer;
-	vk::UniqueDeviceMemory indexBufferMemory;
+//the material variants buildPipelineVariants() builds up front, as {textured, alphaTest}
+const std::array<std::array<uint32_t, 2>, 3> MATERIAL_VARIANTS = {{
+	{1, 0},
+	{0, 0},
+	{1, 1}
+}};
 
-	std::vector<vk::UniqueBuffer> uniformBuffers;
-	std::vector<vk::UniqueDeviceMemory> uniformBuffersMemory;
+const uint32_t MESH_CACHE_MAGIC = 0x4853454D; // "MESH"
+const uint32_t MESH_CACHE_VERSION = 4;
 
-	vk::UniqueDescriptorPool descriptorPool;
-	std::vector<vk::DescriptorSet> descriptorSets;
+//MeshCacheHeader::flags
+const uint32_t MESH_CACHE_OPTIMIZED = 1;
 
-	std::vector<vk::UniqueCommandBuffer> commandBuffers;
+//one per OBJ shape and level of detail, drawn with its own drawIndexed
+struct Submesh {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
 
-	std::vector<vk::UniqueSemaphore> imageAvailableSemaphores;
-	std::vector<vk::UniqueSemaphore> renderFinishedSemaphores;
-	std::vector<vk::UniqueFence> inFlightFences;
-	std::vector<size_t> imagesInFlight;
-	size_t currentFrame = 0;
+//laid out as: header, vertexCount * Vertex, indexCount * uint32_t, submeshCount * Submesh
+//the submeshes are grouped by lod, lodCount groups of submeshCount / lodCount
+struct MeshCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexStride;
+	uint32_t submeshCount;
+	uint32_t flags;
+	uint32_t lodCount;
+	uint64_t sourceSize;
+	int64_t sourceModifiedTime;
+	uint64_t sourceHash;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+};
 
-	void initWindow() {
-		if (SDL_Init(SDL_INIT_VIDEO) < 0)
-			throw std::runtime_error("failed to initialise SDL!");
+const uint32_t PIPELINE_CACHE_MAGIC = 0x45484350; // "PCHE"
+
+//prefixed to the driver's pipeline cache blob, which is only ever handed back to the exact same device and driver
+struct PipelineCacheFileHeader {
+	uint32_t magic;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+	uint64_t dataHash;
+};
 
-		window = SDL_CreateWindow("Vulkan", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WIDTH, HEIGHT, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
-		if (!window)
-			throw std::runtime_error("failed to create window!");
-	}
+//ACMR is measured against a FIFO of this size, roughly what current hardware behaves like
+const uint32_t ACMR_CACHE_SIZE = 16;
+//the LRU cache the vertex cache optimisation models, larger than ACMR_CACHE_SIZE so it still helps on bigger caches
+const uint32_t FORSYTH_CACHE_SIZE = 32;
 
-	void initVulkan() {
-		createInstance();
-		setupDebugMessenger();
-		createSurface();
-		pickPhysicalDevice();
-		createLogicalDevice();
-		createSwapchain();
-		createImageViews();
-		createRenderPass();
-		createDescriptorSetLayout();
-		createGraphicsPipeline();
-		createCommandPool();
-		createColorResources();
-		createDepthResources();
-		createFramebuffers();
-		createTextureImage();
-		createTextureImageView();
-		createTextureSampler();
-		loadModel();
-		createVertexBuffer();
-		createIndexBuffer();
-		createUniformBuffers();
-		createDescriptorPool();
-		createDescriptorSets();
-		createCommandBuffers();
-		createSyncObjects();
-	}
+//average cache misses per triangle, 0.5 is the best a regular grid can do and 3 means no reuse at all
+float computeAcmr(const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+	if (indexCount < 3)
+		return 0.0f;
 
-	void mainLoop() {
-		while (!quitting) {
-			while (SDL_PollEvent(&event) != 0) {
-				if (event.type == SDL_QUIT) {
-					quitting = true;
-				}
-				if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_RESIZED) {
-					recreateSwapchain();
-				}
-			}
-			drawFrame();
-		}
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	uint32_t time = ACMR_CACHE_SIZE + 1;
+	size_t misses = 0;
 
-		device->waitIdle();
+	for (size_t i = 0; i < indexCount; ++i) {
+		if (time - timestamps[indices[i]] > ACMR_CACHE_SIZE) {
+			timestamps[indices[i]] = time++;
+			++misses;
+		}
 	}
 
-	void cleanup() {
-		SDL_DestroyWindow(window);
+	return static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+}
 
-		SDL_Quit();
+float forsythVertexScore(int cachePosition, uint32_t remainingValence) {
+	if (remainingValence == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		//the triangle that was just drawn gets a fixed score so that it isn't simply used again
+		if (cachePosition < 3)
+			score = 0.75f;
+		else
+			score = std::pow(1.0f - (cachePosition - 3) / static_cast<float>(FORSYTH_CACHE_SIZE - 3), 1.5f);
 	}
 
-	void createInstance() {
-		if (enableValidationLayers && !checkValidationLayerSupport())
-			throw std::runtime_error("validation layers requested, but not available!");
+	//boosts vertices with few triangles left so they get finished off instead of lingering
+	return score + 2.0f * std::pow(static_cast<float>(remainingValence), -0.5f);
+}
 
-		vk::ApplicationInfo applicationInfo(
-			"Hello Triangle", VK_MAKE_VERSION(1, 0, 0),
-			"No Engine", VK_MAKE_VERSION(1, 0, 0),
-			VK_API_VERSION_1_0
-		);
+//Tom Forsyth's linear-speed vertex cache optimisation, greedily emits the best scoring triangle next to the cache
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+	uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+	if (triangleCount == 0)
+		return;
+
+	std::vector<uint32_t> remainingValence(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+		++remainingValence[indices[i]];
+
+	//the triangles using each vertex, the first remainingValence of them are the ones not emitted yet
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingValence[v];
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		for (uint32_t k = 0; k < 3; ++k)
+			adjacency[fill[indices[t * 3 + k]]++] = t;
+	}
 
-		std::vector<const char*> extensions = getRequiredExtensions();
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+		vertexScore[v] = forsythVertexScore(-1, remainingValence[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	uint32_t bestTriangle = 0;
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		if (triangleScore[t] > triangleScore[bestTriangle])
+			bestTriangle = t;
+	}
 
-		size_t layerCount = 0;
-		if (enableValidationLayers)
-			layerCount = validationLayers.size();
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	std::vector<uint32_t> cache, newCache;
+	uint32_t scanCursor = 0;
+
+	while (output.size() < triangleCount * 3) {
+		//nothing next to the cache is left, so start again from the first triangle that hasn't been emitted
+		if (bestTriangle == UINT32_MAX) {
+			while (emitted[scanCursor])
+				++scanCursor;
+			bestTriangle = scanCursor;
+		}
 
-		vk::DebugUtilsMessengerCreateInfoEXT debugMessengerCreateInfo = getDebugUtilsMessengerCreateInfo();
-		vk::InstanceCreateInfo instanceCreateInfo(
-			{}, &applicationInfo,
-			static_cast<uint32_t>(layerCount), validationLayers.data(),
-			static_cast<uint32_t>(extensions.size()), extensions.data()
-		);
-		instanceCreateInfo.pNext = &debugMessengerCreateInfo;
+		const uint32_t* triangle = indices + bestTriangle * 3;
+		emitted[bestTriangle] = true;
 
-		instance = vk::createInstanceUnique(
-			instanceCreateInfo
-		);
-	}
+		newCache.assign(triangle, triangle + 3);
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t v = triangle[k];
+			output.push_back(v);
 
-	vk::DebugUtilsMessengerCreateInfoEXT getDebugUtilsMessengerCreateInfo() {
-		return vk::DebugUtilsMessengerCreateInfoEXT(
-			{},
-			vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose | vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning | vk::DebugUtilsMessageSeverityFlagBitsEXT::eError,
-			vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral | vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation | vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance,
-			&debugCallback
-		);
-	}
+			uint32_t* first = adjacency.data() + adjacencyOffsets[v];
+			uint32_t* last = first + remainingValence[v] - 1;
+			std::iter_swap(std::find(first, last + 1, bestTriangle), last);
+			--remainingValence[v];
+		}
 
-	void setupDebugMessenger() {
-		if (!enableValidationLayers)
-			return;
+		for (uint32_t v : cache) {
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				newCache.push_back(v);
+		}
 
-		debugMessenger = instance->createDebugUtilsMessengerEXTUnique(
-			getDebugUtilsMessengerCreateInfo()
-		);
-	}
+		//rescore everything that moved in the cache, including what just fell out of it, along with their triangles
+		for (size_t i = 0; i < newCache.size(); ++i) {
+			uint32_t v = newCache[i];
+			cachePosition[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+			vertexScore[v] = forsythVertexScore(cachePosition[v], remainingValence[v]);
+		}
 
-	void createSurface() {
-		vk::SurfaceKHR tmpSurface;
-		if (!SDL_Vulkan_CreateSurface(window, static_cast<VkInstance>(instance.get()), reinterpret_cast<VkSurfaceKHR*>(&tmpSurface)))
-			throw std::runtime_error("failed to create SDL surface!");
-		surface = vk::UniqueSurfaceKHR(tmpSurface, instance.get());
-	}
+		bestTriangle = UINT32_MAX;
+		float bestScore = -1.0f;
+		for (uint32_t v : newCache) {
+			for (uint32_t a = 0; a < remainingValence[v]; ++a) {
+				uint32_t t = adjacency[adjacencyOffsets[v] + a];
+				triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
 
-	void pickPhysicalDevice() {
-		bool deviceFound = false;
-		std::vector<vk::PhysicalDevice> physicalDevices = instance->enumeratePhysicalDevices();
+		if (newCache.size() > FORSYTH_CACHE_SIZE)
+			newCache.resize(FORSYTH_CACHE_SIZE);
+		cache.swap(newCache);
+	}
 
-		if (physicalDevices.size() == 0)
-			throw std::runtime_error("failed to find GPUs with Vulkan support!");
+	std::copy(output.begin(), output.end(), indices);
+}
 
-		for (const auto& device : physicalDevices) {
-			if (isDeviceSuitable(device)) {
-				physicalDevice = device;
-				msaaSamples = getMaxUsableSampleCount();
-				deviceFound = true;
-				break;
+//splits the (already cache optimised) triangles into clusters wherever the cache runs cold, so moving clusters around costs
+//next to nothing in cache misses, then draws the clusters facing away from the mesh centre first since they tend to occlude the rest
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount) {
+	uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+	if (triangleCount == 0)
+		return;
+
+	std::vector<uint32_t> clusterStarts;
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	uint32_t time = ACMR_CACHE_SIZE + 1;
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		uint32_t misses = 0;
+		for (uint32_t k = 0; k < 3; ++k) {
+			uint32_t v = indices[t * 3 + k];
+			if (time - timestamps[v] > ACMR_CACHE_SIZE) {
+				timestamps[v] = time++;
+				++misses;
 			}
 		}
 
-		if (!deviceFound)
-			throw std::runtime_error("failed to find a suitable GPU!");
+		if (t == 0 || misses == 3)
+			clusterStarts.push_back(t);
 	}
+	clusterStarts.push_back(triangleCount);
+
+	glm::vec3 meshCentroid(0.0f);
+	for (uint32_t i = 0; i < triangleCount * 3; ++i)
+		meshCentroid += vertices[indices[i]].pos;
+	meshCentroid /= static_cast<float>(triangleCount * 3);
+
+	size_t clusterCount = clusterStarts.size() - 1;
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c) {
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+
+		for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+			const glm::vec3& p0 = vertices[indices[t * 3]].pos;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+			centroid += p0 + p1 + p2;
+			//unnormalised, so bigger triangles count for more
+			normal += glm::cross(p1 - p0, p2 - p0);
+		}
 
-	vk::SampleCountFlagBits getMaxUsableSampleCount() {
-		vk::PhysicalDeviceProperties physicalDeviceProperties = physicalDevice.getProperties();
+		centroid /= static_cast<float>((clusterStarts[c + 1] - clusterStarts[c]) * 3);
+		float length = glm::length(normal);
+		sortKeys[c] = length > 0.0f ? glm::dot(centroid - meshCentroid, normal / length) : 0.0f;
+	}
 
-		vk::SampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts &
-			physicalDeviceProperties.limits.framebufferDepthSampleCounts;
-		if (counts & vk::SampleCountFlagBits::e64) return vk::SampleCountFlagBits::e64;
-		if (counts & vk::SampleCountFlagBits::e32) return vk::SampleCountFlagBits::e32;
-		if (counts & vk::SampleCountFlagBits::e16) return vk::SampleCountFlagBits::e16;
-		if (counts & vk::SampleCountFlagBits::e8) return vk::SampleCountFlagBits::e8;
-		if (counts & vk::SampleCountFlagBits::e4) return vk::SampleCountFlagBits::e4;
-		if (counts & vk::SampleCountFlagBits::e2) return vk::SampleCountFlagBits::e2;
+	std::vector<uint32_t> clusterOrder(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c)
+		clusterOrder[c] = static_cast<uint32_t>(c);
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t a, uint32_t b) {
+		return sortKeys[a] > sortKeys[b];
+	});
 
-		return vk::SampleCountFlagBits::e1;
-	}
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	for (uint32_t c : clusterOrder)
+		output.insert(output.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
 
-	void createLogicalDevice() {
-		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+	std::copy(output.begin(), output.end(), indices);
+}
 
-		std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
-		std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+//runs the cache and overdraw optimisations on one submesh. their tables are sized by vertex count, so the submesh is
+//renumbered onto just the vertices it uses first and the cost follows its own size rather than the whole mesh's
+void optimizeSubmesh(uint32_t* indices, size_t indexCount, const Vertex* vertices) {
+	std::vector<uint32_t> usedVertices(indices, indices + indexCount);
+	std::sort(usedVertices.begin(), usedVertices.end());
+	usedVertices.erase(std::unique(usedVertices.begin(), usedVertices.end()), usedVertices.end());
 
-		float queuePriority = 1.0f;
-		for (uint32_t queueFamily : uniqueQueueFamilies) {
-			queueCreateInfos.push_back(
-				vk::DeviceQueueCreateInfo({}, queueFamily, 1, &queuePriority)
-			);
-		}
+	std::vector<uint32_t> localIndices(indexCount);
+	for (size_t i = 0; i < indexCount; ++i)
+		localIndices[i] = static_cast<uint32_t>(std::lower_bound(usedVertices.begin(), usedVertices.end(), indices[i]) - usedVertices.begin());
 
-		vk::PhysicalDeviceFeatures deviceFeatures = {};
-		deviceFeatures.samplerAnisotropy = true;
-		deviceFeatures.sampleRateShading = true;
+	std::vector<Vertex> localVertices(usedVertices.size());
+	for (size_t v = 0; v < usedVertices.size(); ++v)
+		localVertices[v] = vertices[usedVertices[v]];
 
-		uint32_t enabledLayerCount = 0;
-		if (enableValidationLayers)
-			enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-		
-		device = physicalDevice.createDeviceUnique(
-			vk::DeviceCreateInfo(
-				{},
-				static_cast<uint32_t>(queueCreateInfos.size()), queueCreateInfos.data(),
-				enabledLayerCount, validationLayers.data(),
-				static_cast<uint32_t>(deviceExtensions.size()), deviceExtensions.data(),
-				&deviceFeatures
-			)
-		);
+	optimizeVertexCache(localIndices.data(), indexCount, localVertices.size());
+	optimizeOverdraw(localIndices.data(), indexCount, localVertices.data(), localVertices.size());
 
-		graphicsQueue = device->getQueue(indices.graphicsFamily.value(), 0);
-		presentQueue = device->getQueue(indices.presentFamily.value(), 0);
+	for (size_t i = 0; i < indexCount; ++i)
+		indices[i] = usedVertices[localIndices[i]];
+}
+
+//renumbers vertices in the order the index buffer first uses them, which also drops any that aren't referenced
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
 	}
 
-	void createSwapchain() {
-		SwapchainSupportDetails swapchainSupport = querySwapchainSupport(physicalDevice);
+	vertices.swap(reordered);
+}
 
-		vk::SurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapchainSupport.formats);
-		vk::PresentModeKHR presentMode = chooseSwapPresentMode(swapchainSupport.presentModes);
-		vk::Extent2D extent = chooseSwapExtent(swapchainSupport.capabilities);
+//the OBJ parsing behind --stream-mesh works on a mapped file a line at a time, so nothing here may read past end
+const char* skipObjSpaces(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+		++p;
+	return p;
+}
 
-		uint32_t imageCount = swapchainSupport.capabilities.minImageCount + 1;
-		if (swapchainSupport.capabilities.maxImageCount > 0 && imageCount > swapchainSupport.capabilities.maxImageCount)
-			imageCount = swapchainSupport.capabilities.maxImageCount;
+const char* findObjLineEnd(const char* p, const char* end) {
+	const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+	return newline ? newline : end;
+}
 
-		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
-		uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+//true for a line that starts with the given keyword followed by whitespace
+bool isObjKeyword(const char* line, const char* lineEnd, const char* keyword) {
+	size_t length = strlen(keyword);
+	return static_cast<size_t>(lineEnd - line) > length && memcmp(line, keyword, length) == 0 &&
+		(line[length] == ' ' || line[length] == '\t');
+}
 
-		vk::SharingMode sharingMode = vk::SharingMode::eExclusive;
-		if (indices.graphicsFamily != indices.presentFamily)
-			sharingMode = vk::SharingMode::eConcurrent;
-		
-		swapchain = device->createSwapchainKHRUnique(
-			vk::SwapchainCreateInfoKHR(
-				vk::SwapchainCreateFlagsKHR(), surface.get(),
-				imageCount, surfaceFormat.format,
-				surfaceFormat.colorSpace, extent,
-				1, vk::ImageUsageFlagBits::eColorAttachment,
-				sharingMode, 2, queueFamilyIndices,
-				swapchainSupport.capabilities.currentTransform, vk::CompositeAlphaFlagBitsKHR::eOpaque,
-				presentMode, true,
-				nullptr
-			)
-		);
+bool parseObjFloat(const char*& p, const char* end, float& value) {
+	p = skipObjSpaces(p, end);
+	auto result = std::from_chars(p, end, value);
+	if (result.ec != std::errc())
+		return false;
+	p = result.ptr;
+	return true;
+}
 
-		swapchainImages = device->getSwapchainImagesKHR(swapchain.get());
-		swapchainImageFormat = surfaceFormat.format;
-		swapchainExtent = extent;
+//OBJ indices start at 1 and count back from the latest element when negative, 0 marks one that was left out
+struct ObjCorner {
+	int64_t position = 0;
+	int64_t texCoord = 0;
+};
+
+bool parseObjCorner(const char*& p, const char* end, ObjCorner& corner) {
+	p = skipObjSpaces(p, end);
+	auto result = std::from_chars(p, end, corner.position);
+	if (result.ec != std::errc())
+		return false;
+	p = result.ptr;
+
+	corner.texCoord = 0;
+	if (p < end && *p == '/' && p + 1 < end && p[1] != '/') {
+		result = std::from_chars(p + 1, end, corner.texCoord);
+		if (result.ec != std::errc())
+			return false;
+		p = result.ptr;
 	}
 
-	void createImageViews() {
-		swapchainImageViews.resize(swapchainImages.size());
+	//the normal isn't used
+	while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+		++p;
+	return true;
+}
 
-		for (size_t i = 0; i < swapchainImages.size(); ++i) {
-			swapchainImageViews[i] = createImageView(swapchainImages[i], swapchainImageFormat, vk::ImageAspectFlagBits::eColor, 1);
-		}
-	}
+//resolves a parsed index against the number of elements defined so far, UINT32_MAX when it was left out
+uint32_t resolveObjIndex(int64_t index, size_t definedCount) {
+	if (index == 0)
+		return UINT32_MAX;
 
-	void createRenderPass() {
-		vk::AttachmentDescription colorAttachment = {};
-		colorAttachment.format = swapchainImageFormat;
-		colorAttachment.samples = msaaSamples;
-		colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
-		colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
-		colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
-		colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-		colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
-		colorAttachment.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
+	int64_t resolved = index > 0 ? index - 1 : static_cast<int64_t>(definedCount) + index;
+	if (resolved < 0 || resolved >= static_cast<int64_t>(definedCount))
+		throw std::runtime_error("face refers to a vertex that doesn't exist in " + MODEL_PATH);
+	return static_cast<uint32_t>(resolved);
+}
 
-		vk::AttachmentDescription depthAttachment = {};
-		depthAttachment.format = findDepthFormat();
-		depthAttachment.samples = msaaSamples;
-		depthAttachment.loadOp = vk::AttachmentLoadOp::eClear;
-		depthAttachment.storeOp = vk::AttachmentStoreOp::eDontCare;
-		depthAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
-		depthAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-		depthAttachment.initialLayout = vk::ImageLayout::eUndefined;
-		depthAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+//each half of the --stream-mesh staging buffer, one is filled while the copy out of the other runs
+const vk::DeviceSize MESH_STREAM_CHUNK_SIZE = 4 * 1024 * 1024;
+
+//levels of detail generated for every mesh, each one aims for half the triangles of the one before
+const uint32_t MESH_LOD_COUNT = 4;
+//projected radius of the mesh's bounding sphere in pixels below which coarser lods take over
+const float LOD_FULL_DETAIL_RADIUS = 128.0f;
+//the finest clustering grid a lod may use, the first lod's search starts from a grid a quarter as fine
+const uint32_t LOD_GRID_MAX_RESOLUTION = 1024;
+//clustering passes a lod's grid search may take, it usually settles on a grid within a few percent in two or three
+const uint32_t LOD_SEARCH_PROBES = 6;
+
+//vertex clustering on a gridResolution^3 grid over the mesh bounds, every vertex maps to the vertex of its cell
+//closest to the cell's average position, so a simplified mesh keeps using the original vertex buffer
+std::vector<uint32_t> clusterVertices(const Vertex* vertices, size_t vertexCount, uint32_t gridResolution) {
+	glm::vec3 minPosition(std::numeric_limits<float>::max());
+	glm::vec3 maxPosition(-std::numeric_limits<float>::max());
+	for (size_t i = 0; i < vertexCount; ++i) {
+		minPosition = glm::min(minPosition, vertices[i].pos);
+		maxPosition = glm::max(maxPosition, vertices[i].pos);
+	}
+	glm::vec3 cellScale = static_cast<float>(gridResolution) / glm::max(maxPosition - minPosition, glm::vec3(1e-6f));
 
-		vk::AttachmentDescription colorAttachmentResolve = {};
-		colorAttachmentResolve.format = swapchainImageFormat;
-		colorAttachmentResolve.samples = vk::SampleCountFlagBits::e1;
-		colorAttachmentResolve.loadOp = vk::AttachmentLoadOp::eDontCare;
-		colorAttachmentResolve.storeOp = vk::AttachmentStoreOp::eStore;
-		colorAttachmentResolve.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
-		colorAttachmentResolve.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-		colorAttachmentResolve.initialLayout = vk::ImageLayout::eUndefined;
-		colorAttachmentResolve.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+	std::vector<std::pair<uint64_t, uint32_t>> cells(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i) {
+		glm::uvec3 cell = glm::min(glm::uvec3((vertices[i].pos - minPosition) * cellScale), glm::uvec3(gridResolution - 1));
+		cells[i] = {(static_cast<uint64_t>(cell.z) * gridResolution + cell.y) * gridResolution + cell.x, static_cast<uint32_t>(i)};
+	}
+	std::sort(cells.begin(), cells.end());
+
+	std::vector<uint32_t> remap(vertexCount);
+	for (size_t begin = 0; begin < vertexCount;) {
+		size_t end = begin;
+		glm::vec3 center(0.0f);
+		while (end < vertexCount && cells[end].first == cells[begin].first)
+			center += vertices[cells[end++].second].pos;
+		center /= static_cast<float>(end - begin);
+
+		uint32_t representative = cells[begin].second;
+		float bestDistance = std::numeric_limits<float>::max();
+		for (size_t i = begin; i < end; ++i) {
+			glm::vec3 offset = vertices[cells[i].second].pos - center;
+			if (glm::dot(offset, offset) < bestDistance) {
+				bestDistance = glm::dot(offset, offset);
+				representative = cells[i].second;
+			}
+		}
 
-		vk::AttachmentReference colorAttachmentRef(0, vk::ImageLayout::eColorAttachmentOptimal);
+		for (size_t i = begin; i < end; ++i)
+			remap[cells[i].second] = representative;
+		begin = end;
+	}
 
-		vk::AttachmentReference depthAttachmentRef(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+	return remap;
+}
 
-		vk::AttachmentReference colorAttachmentResolveRef(2, vk::ImageLayout::eColorAttachmentOptimal);
+//returns how many triangles survive the remap and appends them to destination if there is one, collapsed ones are dropped
+size_t remapTriangles(const uint32_t* indices, size_t indexCount, const std::vector<uint32_t>& remap, std::vector<uint32_t>* destination) {
+	size_t triangles = 0;
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		uint32_t a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+		if (a == b || b == c || a == c)
+			continue;
+
+		++triangles;
+		if (destination)
+			destination->insert(destination->end(), {a, b, c});
+	}
 
-		vk::SubpassDescription subpass;
-		subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorAttachmentRef;
-		subpass.pDepthStencilAttachment = &depthAttachmentRef;
-		subpass.pResolveAttachments = &colorAttachmentResolveRef;
+	return triangles;
+}
 
-		vk::SubpassDependency dependency(
-			(uint32_t) VK_SUBPASS_EXTERNAL, (uint32_t) 0,
-			vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput,
-			vk::AccessFlags(), vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
-			vk::DependencyFlags()
-		);
+//distance is measured from the near plane, full detail up to lodDistance and one level coarser every time it doubles after that
+uint32_t selectLod(float distance, float lodDistance, uint32_t lodCount) {
+	if (distance <= lodDistance)
+		return 0;
 
-		std::array<vk::AttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
-		renderPass = device->createRenderPassUnique(
-			vk::RenderPassCreateInfo(
-				vk::RenderPassCreateFlags(), static_cast<uint32_t>(attachments.size()), attachments.data(), 1, &subpass, 1, &dependency
-			)
-		);
-	}
+	return std::min(static_cast<uint32_t>(std::log2(distance / lodDistance)) + 1, lodCount - 1);
+}
 
-	void createDescriptorSetLayout() {
-		vk::DescriptorSetLayoutBinding uboLayoutBinding = {};
-		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.descriptorType = vk::DescriptorType::eUniformBuffer;
-		uboLayoutBinding.descriptorCount = 1;
-		uboLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eVertex;
-		uboLayoutBinding.pImmutableSamplers = nullptr;
+//gribb/hartmann plane extraction for a [0, 1] depth range, normals point into the frustum and are normalised
+std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4& viewProj) {
+	auto row = [&](int i) {
+		return glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+	};
 
-		vk::DescriptorSetLayoutBinding samplerLayoutBinding = {};
-		samplerLayoutBinding.binding = 1;
-		samplerLayoutBinding.descriptorCount = 1;
-		samplerLayoutBinding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
-		samplerLayoutBinding.pImmutableSamplers = nullptr;
-		samplerLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+	std::array<glm::vec4, 6> planes = {
+		row(3) + row(0), row(3) - row(0),
+		row(3) + row(1), row(3) - row(1),
+		row(2), row(3) - row(2)
+	};
+	for (auto& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
 
-		std::array<vk::DescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
-		vk::DescriptorSetLayoutCreateInfo layoutInfo = {};
-		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-		layoutInfo.pBindings = bindings.data();
+	return planes;
+}
 
-		descriptorSetLayout = device->createDescriptorSetLayoutUnique(layoutInfo);
-	}
+struct ApplicationOptions {
+	//0 picks one less than the number of hardware threads
+	uint32_t workerThreads = 0;
+	//prints a once a second summary of the frame timings
+	bool profile = false;
+	//writes every frame's timings to this file
+	std::string profileCsvPath;
+	//renders this many frames with a fixed animation step, then reports frame time statistics and quits
+	uint32_t benchmarkFrames = 0;
+	//renders into an image of our own instead of the swapchain, without a window or surface, and never presents
+	bool offscreen = false;
+	//with --offscreen, copies every frame back and writes it to this directory as a png
+	std::string readbackDirectory;
+	//quits after this many frames, 0 runs until the window is closed
+	uint32_t frameCount = 0;
+	//reorders the mesh for the post-transform cache, overdraw and vertex fetch before it is cached
+	bool optimizeMesh = false;
+	VertexFormat vertexFormat = VertexFormat::eFull;
+	//copies of the model drawn with a single instanced draw per submesh
+	uint32_t instanceCount = 1;
+	uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+	//how many frames the cpu may queue ahead of the gpu, 0 allows as many as there are frames in flight
+	uint32_t maxLatency = 0;
+	//paces frames with a timeline semaphore instead of a fence per frame when VK_KHR_timeline_semaphore is available
+	bool timelineSemaphores = false;
+	//frustum culls the instances in a compute pass and draws the survivors indirectly
+	bool gpuCulling = false;
+	//binds every texture at once through VK_EXT_descriptor_indexing, draws select theirs with a push constant
+	bool bindless = false;
+	//0 uses the most the device can do, 1 renders straight into the swapchain image without a resolve
+	uint32_t msaaSamples = 0;
+	//backs the msaa color and depth attachments with lazily allocated memory where the device has it
+	bool lazyAttachments = false;
+	//compiles the GLSL sources at startup through the SPIR-V cache and rebuilds pipelines when they change
+	bool hotReload = false;
+	//which of the material pipeline variants the model is drawn with
+	bool untextured = false;
+	bool alphaTest = false;
+	//unset prefers mailbox and falls back to fifo, an unsupported request falls back to fifo
+	std::optional<vk::PresentModeKHR> presentMode;
+	//0 asks for one more than the surface's minimum
+	uint32_t swapchainImages = 0;
+	//0 leaves the pacing to the present mode
+	uint32_t fpsLimit = 0;
+	//starts with the mip tail resident and streams the larger levels in as the view needs them
+	bool streamTextures = false;
+	//MiB the streamed texture may use, 0 leaves it to VK_EXT_memory_budget where that is available
+	uint32_t textureBudget = 0;
+	//parses the OBJ straight from a mapping into bounded staging memory, without the cache, lods or optimisation
+	bool streamMesh = false;
+	//an index into the enumerated devices or part of a device name, empty picks the best scoring one
+	std::string gpu;
+	//renders alternate frames on the devices of the chosen device's group, if it is linked to others
+	bool deviceGroup = false;
+	//begins rendering straight on the image views with VK_KHR_dynamic_rendering, without a render pass or framebuffers
+	bool dynamicRendering = false;
+	//records cpu scopes on every thread and writes them to this file as a chrome trace on exit
+	std::string tracePath;
+};
 
-	void createGraphicsPipeline() {
-		auto vertShaderCode = readFile("shaders/vert.spv");
-		auto fragShaderCode = readFile("shaders/frag.spv");
+ApplicationOptions parseCommandLine(int argc, char* argv[]) {
+	ApplicationOptions options;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string argument = argv[i];
+
+		auto nextValue = [&]() -> std::string {
+			if (i + 1 >= argc)
+				throw std::invalid_argument("missing value for " + argument);
+			return argv[++i];
+		};
+
+		if (argument == "--threads")
+			options.workerThreads = static_cast<uint32_t>(std::stoul(nextValue()));
+		else if (argument == "--profile")
+			options.profile = true;
+		else if (argument == "--profile-csv")
+			options.profileCsvPath = nextValue();
+		else if (argument == "--benchmark")
+			options.benchmarkFrames = static_cast<uint32_t>(std::stoul(nextValue()));
+		else if (argument == "--offscreen")
+			options.offscreen = true;
+		else if (argument == "--readback")
+			options.readbackDirectory = nextValue();
+		else if (argument == "--frames")
+			options.frameCount = static_cast<uint32_t>(std::stoul(nextValue()));
+		else if (argument == "--optimize-mesh")
+			options.optimizeMesh = true;
+		else if (argument == "--instances")
+			options.instanceCount = std::max(static_cast<uint32_t>(std::stoul(nextValue())), 1u);
+		else if (argument == "--vertex-format") {
+			std::string format = nextValue();
+			if (format == "full")
+				options.vertexFormat = VertexFormat::eFull;
+			else if (format == "half")
+				options.vertexFormat = VertexFormat::eHalf;
+			else if (format == "unorm16")
+				options.vertexFormat = VertexFormat::eUnorm16;
+			else
+				throw std::invalid_argument("unknown vertex format " + format);
+		}
+		else if (argument == "--frames-in-flight")
+			options.framesInFlight = static_cast<uint32_t>(std::stoul(nextValue()));
+		else if (argument == "--max-latency")
+			options.maxLatency = static_cast<uint32_t>(std::stoul(nextValue()));
+		else if (argument == "--timeline")
+			options.timelineSemaphores = true;
+		else if (argument == "--gpu-culling")
+			options.gpuCulling = true;
+		else if (argument == "--bindless")
+			options.bindless = true;
+		else if (argument == "--msaa") {
+			options.msaaSamples = static_cast<uint32_t>(std::stoul(nextValue()));
+			if (options.msaaSamples == 0 || options.msaaSamples > 64 || (options.msaaSamples & (options.msaaSamples - 1)) != 0)
+				throw std::invalid_argument("--msaa must be a power of two from 1 to 64");
+		}
+		else if (argument == "--lazy-attachments")
+			options.lazyAttachments = true;
+		else if (argument == "--hot-reload")
+			options.hotReload = true;
+		else if (argument == "--untextured")
+			options.untextured = true;
+		else if (argument == "--alpha-test")
+			options.alphaTest = true;
+		else if (argument == "--present-mode") {
+			std::string mode = nextValue();
+			if (mode == "immediate")
+				options.presentMode = vk::PresentModeKHR::eImmediate;
+			else if (mode == "mailbox")
+				options.presentMode = vk::PresentModeKHR::eMailbox;
+			else if (mode == "fifo")
+				options.presentMode = vk::PresentModeKHR::eFifo;
+			else if (mode == "fifo-relaxed")
+				options.presentMode = vk::PresentModeKHR::eFifoRelaxed;
+			else
+				throw std::invalid_argument("unknown present mode " + mode);
+		}
+		else if (argument == "--swapchain-images")
+			options.swapchainImages = static_cast<uint32_t>(std::stoul(nextValue()));
+		else if (argument == "--fps-limit")
+			options.fpsLimit = static_cast<uint32_t>(std::stoul(nextValue()));
+		else if (argument == "--stream-textures")
+			options.streamTextures = true;
+		else if (argument == "--texture-budget")
+			options.textureBudget = static_cast<uint32_t>(std::stoul(nextValue()));
+		else if (argument == "--stream-mesh")
+			options.streamMesh = true;
+		else if (argument == "--gpu")
+			options.gpu = nextValue();
+		else if (argument == "--device-group")
+			options.deviceGroup = true;
+		else if (argument == "--dynamic-rendering")
+			options.dynamicRendering = true;
+		else if (argument == "--trace")
+			options.tracePath = nextValue();
+		else
+			throw std::invalid_argument("unknown option " + argument);
+	}
 
-		vk::UniqueShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-		vk::UniqueShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+	if (options.framesInFlight == 0)
+		throw std::invalid_argument("--frames-in-flight must be at least 1");
+	if (!options.readbackDirectory.empty() && !options.offscreen)
+		throw std::invalid_argument("--readback needs --offscreen");
 
-		vk::PipelineShaderStageCreateInfo vertShaderStageInfo(
-			vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eVertex, vertShaderModule.get(), "main"
-		);
-		vk::PipelineShaderStageCreateInfo fragShaderStageInfo(
-			vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eFragment, fragShaderModule.get(), "main"
-		);
+	return options;
+}
 
-		vk::PipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+//a finished cpu scope, names have to outlive the profiler so they are always string literals
+struct CpuTraceEvent {
+	const char* name;
+	uint64_t startNs;
+	uint64_t durationNs;
+	uint64_t frame;
+};
 
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+//events kept per thread, a thread that records more than this before the trace is written loses its oldest ones
+const uint64_t CPU_TRACE_RING_SIZE = 1 << 16;
 
-		vk::PipelineVertexInputStateCreateInfo vertexInputInfo(
-			vk::PipelineVertexInputStateCreateFlags(), 
-			1, &bindingDescription,
-			attributeDescriptions.size(), attributeDescriptions.data()
-		);
+//only the owning thread writes to a ring, it publishes each event by bumping head so recording never takes a lock
+struct CpuTraceRing {
+	std::vector<CpuTraceEvent> events = std::vector<CpuTraceEvent>(CPU_TRACE_RING_SIZE);
+	std::atomic<uint64_t> head{0};
+	uint32_t threadId = 0;
+	std::string threadName;
+};
 
-		vk::PipelineInputAssemblyStateCreateInfo inputAssembly(
-			vk::PipelineInputAssemblyStateCreateFlags(), vk::PrimitiveTopology::eTriangleList, false
-		);
+//every thread gets its ring the first time it records, there is nothing to set up per thread beyond an optional name
+class CpuProfiler {
+public:
+	static void enable() {
+		epoch = std::chrono::steady_clock::now();
+		enabled.store(true, std::memory_order_relaxed);
+	}
 
-		vk::Viewport viewport(0.0f, 0.0f, (float) swapchainExtent.width, (float) swapchainExtent.height, 0.0f, 1.0f);
+	static bool isEnabled() {
+		return enabled.load(std::memory_order_relaxed);
+	}
 
-		vk::Rect2D scissor({0, 0}, swapchainExtent);
+	//shows up in the trace instead of the thread's number, has to be called before the thread records anything
+	static void nameThread(std::string name) {
+		threadName = std::move(name);
+	}
 
-		vk::PipelineViewportStateCreateInfo viewportState(
-			vk::PipelineViewportStateCreateFlags(), 1, &viewport, 1, &scissor
-		);
+	//tags the events that follow on every thread, so they can be matched up with the frame's debug labels
+	static void setFrame(uint64_t frame) {
+		currentFrame.store(frame, std::memory_order_relaxed);
+	}
 
-		vk::PipelineRasterizationStateCreateInfo rasterizer(
-			vk::PipelineRasterizationStateCreateFlags(), false, false,
-			vk::PolygonMode::eFill, vk::CullModeFlagBits::eBack, vk::FrontFace::eCounterClockwise, 
-			false, 0.0f, 0.0f, 0.0f, 1.0f
-		);
+	static uint64_t now() {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+	}
 
-		vk::PipelineMultisampleStateCreateInfo multisampling(
-			vk::PipelineMultisampleStateCreateFlags(), msaaSamples, 
-			true, 0.2f, nullptr, false, false
-		);
+	static void record(const char* name, uint64_t startNs, uint64_t endNs) {
+		CpuTraceRing& ring = getThreadRing();
+		uint64_t head = ring.head.load(std::memory_order_relaxed);
+		ring.events[head % CPU_TRACE_RING_SIZE] = {name, startNs, endNs - startNs, currentFrame.load(std::memory_order_relaxed)};
+		ring.head.store(head + 1, std::memory_order_release);
+	}
 
-		vk::PipelineDepthStencilStateCreateInfo depthStencil = {};
-		depthStencil.depthTestEnable = true;
-		depthStencil.depthWriteEnable = true;
-		depthStencil.depthCompareOp = vk::CompareOp::eLess;
-		depthStencil.depthBoundsTestEnable = false;
-		depthStencil.stencilTestEnable = false;
+	//complete events in microseconds, which chrome://tracing and Perfetto both open, only call it while the other threads are idle
+	static void writeChromeTrace(const std::string& path) {
+		std::ofstream file(path);
+		if (!file)
+			throw std::runtime_error("failed to open " + path);
+
+		file.setf(std::ios::fixed);
+		file.precision(3);
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+		std::lock_guard<std::mutex> lock(ringsMutex);
+		bool first = true;
+		for (const auto& ring : rings) {
+			file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->threadId
+				<< ",\"args\":{\"name\":\"" << ring->threadName << "\"}}";
+			first = false;
+
+			uint64_t head = ring->head.load(std::memory_order_acquire);
+			for (uint64_t i = head > CPU_TRACE_RING_SIZE ? head - CPU_TRACE_RING_SIZE : 0; i < head; ++i) {
+				const CpuTraceEvent& event = ring->events[i % CPU_TRACE_RING_SIZE];
+				file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->threadId
+					<< ",\"ts\":" << event.startNs / 1000.0 << ",\"dur\":" << event.durationNs / 1000.0
+					<< ",\"args\":{\"frame\":" << event.frame << "}}";
+			}
+		}
 
-		vk::PipelineColorBlendAttachmentState colorBlendAttachment;
-		colorBlendAttachment.blendEnable = false;
-		colorBlendAttachment.colorWriteMask =
-			vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-			vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+		file << "\n]}" << std::endl;
+		if (!file)
+			throw std::runtime_error("failed to write " + path);
+	}
 
-		vk::PipelineColorBlendStateCreateInfo colorBlending(
-			vk::PipelineColorBlendStateCreateFlags(), false, vk::LogicOp::eClear, 1, &colorBlendAttachment
-		);
+private:
+	static inline std::atomic<bool> enabled{false};
+	static inline std::atomic<uint64_t> currentFrame{0};
+	static inline std::chrono::steady_clock::time_point epoch;
+
+	//rings are never freed, a thread that exits still has its events written out
+	static inline std::mutex ringsMutex;
+	static inline std::vector<std::unique_ptr<CpuTraceRing>> rings;
+
+	static inline thread_local CpuTraceRing* threadRing = nullptr;
+	static inline thread_local std::string threadName;
+
+	static CpuTraceRing& getThreadRing() {
+		if (!threadRing) {
+			std::lock_guard<std::mutex> lock(ringsMutex);
+			rings.push_back(std::make_unique<CpuTraceRing>());
+			threadRing = rings.back().get();
+			threadRing->threadId = static_cast<uint32_t>(rings.size());
+			threadRing->threadName = threadName.empty() ? "thread " + std::to_string(rings.size()) : threadName;
+		}
+		return *threadRing;
+	}
+};
 
-		pipelineLayout = device->createPipelineLayoutUnique(
-			vk::PipelineLayoutCreateInfo(
-				vk::PipelineLayoutCreateFlags(),
-				1, &descriptorSetLayout.get(),
-				0, nullptr
-			)
-		);
+//times the enclosing block while the profiler is enabled, otherwise it costs a relaxed load
+class CpuScope {
+public:
+	explicit CpuScope(const char* name) {
+		if (CpuProfiler::isEnabled()) {
+			this->name = name;
+			start = CpuProfiler::now();
+		}
+	}
 
-		vk::GraphicsPipelineCreateInfo pipelineInfo;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = &depthStencil;
-		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.layout = pipelineLayout.get();
-		pipelineInfo.renderPass = renderPass.get();
-		pipelineInfo.subpass = 0;
+	CpuScope(const CpuScope&) = delete;
+	CpuScope& operator=(const CpuScope&) = delete;
 
-		graphicsPipelines = device->createGraphicsPipelinesUnique({}, pipelineInfo);
+	~CpuScope() {
+		if (name)
+			CpuProfiler::record(name, start, CpuProfiler::now());
 	}
 
-	void createFramebuffers() {
-		swapchainFramebuffers.resize(swapchainImageViews.size());
+private:
+	const char* name = nullptr;
+	uint64_t start = 0;
+};
 
-		for (size_t i = 0; i < swapchainImageViews.size(); ++i) {
-			std::array<vk::ImageView, 3> attachments = {colorImageView.get(), depthImageView.get(), swapchainImageViews[i].get()};
+class ThreadPool {
+public:
+	explicit ThreadPool(uint32_t threadCount) {
+		for (uint32_t i = 0; i < threadCount; ++i)
+			threads.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
 
-			swapchainFramebuffers[i] = device->createFramebufferUnique(
-				vk::FramebufferCreateInfo(
-					vk::FramebufferCreateFlags(), renderPass.get(),
-					static_cast<uint32_t>(attachments.size()), attachments.data(),
-					swapchainExtent.width, swapchainExtent.height,
-					1
-				)
-			);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
 		}
+		condition.notify_all();
+
+		for (auto& thread : threads)
+			thread.join();
 	}
 
-	void createColorResources() {
-		vk::Format colorFormat = swapchainImageFormat;
+	uint32_t size() const {
+		return static_cast<uint32_t>(threads.size());
+	}
 
-		createImage(
-			swapchainExtent.width, swapchainExtent.height, 1, msaaSamples, colorFormat, vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal,
-			colorImage, colorImageMemory
-		);
+	//queues a job that is handed the index of the worker running it
+	void enqueue(std::function<void(uint32_t)> job) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(std::move(job));
+		}
+		condition.notify_one();
+	}
 
-		colorImageView = createImageView(colorImage.get(), colorFormat, vk::ImageAspectFlagBits::eColor, 1);
+	//runs job(workerIndex) on some worker, exceptions and the result come back through the future
+	template<typename Job>
+	auto submit(Job job) -> std::future<decltype(job(0u))> {
+		auto task = std::make_shared<std::packaged_task<decltype(job(0u))(uint32_t)>>(std::move(job));
+		enqueue([task](uint32_t workerIndex) { (*task)(workerIndex); });
+		return task->get_future();
 	}
 
-	void createCommandPool() {
-		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+	//runs job(index, workerIndex) for every index in [0, count) and returns once all of them have finished
+	void parallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& job) {
+		if (count == 0)
+			return;
 
-		commandPool = device->createCommandPoolUnique(
-			vk::CommandPoolCreateInfo(
-				vk::CommandPoolCreateFlags(), queueFamilyIndices.graphicsFamily.value()
-			)
-		);
-	}
+		//the queued helpers may only get to run after this returns, so what they touch is shared and job is only
+		//dereferenced after claiming an index, which can't happen once every index has finished
+		struct Batch {
+			const std::function<void(uint32_t, uint32_t)>* job;
+			uint32_t count;
+			std::atomic<uint32_t> next{0};
+			std::atomic<uint32_t> remaining;
+			std::mutex doneMutex;
+			std::condition_variable done;
+			std::exception_ptr error;
+
+			//claims indices of this batch only until there are none left
+			void run(uint32_t workerIndex) {
+				for (uint32_t index = next.fetch_add(1); index < count; index = next.fetch_add(1)) {
+					try {
+						(*job)(index, workerIndex);
+					} catch (...) {
+						std::lock_guard<std::mutex> lock(doneMutex);
+						if (!error)
+							error = std::current_exception();
+					}
+
+					//decremented under the lock so the caller can't return and destroy done while it is being notified
+					std::lock_guard<std::mutex> lock(doneMutex);
+					if (remaining.fetch_sub(1) == 1)
+						done.notify_one();
+				}
+			}
+		};
 
-	void createDepthResources() {
-		vk::Format depthFormat = findDepthFormat();
+		auto batch = std::make_shared<Batch>();
+		batch->job = &job;
+		batch->count = count;
+		batch->remaining = count;
 
-		createImage(
-			swapchainExtent.width, swapchainExtent.height, 1, msaaSamples, depthFormat, vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal,
-			depthImage, depthImageMemory
-		);
+		for (uint32_t i = 0; i < std::min(count, size()); ++i) {
+			enqueue([batch](uint32_t workerIndex) { batch->run(workerIndex); });
+		}
 
-		depthImageView = createImageView(depthImage.get(), depthFormat, vk::ImageAspectFlagBits::eDepth, 1);
-	}
+		//a worker blocking on jobs it queued itself could starve the pool, so it works through its own indices too.
+		//anything else on the queue is left alone, and the wait below blocks rather than spins
+		if (currentPool == this)
+			batch->run(currentWorkerIndex);
 
-	vk::Format findSupportedFormat(const std::vector<vk::Format>& candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features) {
-		for (vk::Format format : candidates) {
-			vk::FormatProperties props = physicalDevice.getFormatProperties(format);
+		std::unique_lock<std::mutex> lock(batch->doneMutex);
+		batch->done.wait(lock, [&] { return batch->remaining.load() == 0; });
 
-			if (tiling == vk::ImageTiling::eLinear && (props.linearTilingFeatures & features) == features) {
-				return format;
-			} else if (tiling == vk::ImageTiling::eOptimal && (props.optimalTilingFeatures & features) == features) {
-				return format;
+		if (batch->error)
+			std::rethrow_exception(batch->error);
+	}
+
+private:
+	std::vector<std::thread> threads;
+	std::deque<std::function<void(uint32_t)>> jobs;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+
+	static inline thread_local ThreadPool* currentPool = nullptr;
+	static inline thread_local uint32_t currentWorkerIndex = 0;
+
+	void workerLoop(uint32_t workerIndex) {
+		currentPool = this;
+		currentWorkerIndex = workerIndex;
+		CpuProfiler::nameThread("worker " + std::to_string(workerIndex));
+
+		while (true) {
+			std::function<void(uint32_t)> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [&] { return stopping || !jobs.empty(); });
+				if (jobs.empty())
+					return;
+
+				job = std::move(jobs.front());
+				jobs.pop_front();
 			}
+
+			CpuScope scope("job");
+			job(workerIndex);
 		}
+	}
+};
 
-		throw std::runtime_error("failed to find supported format!");
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept {
+		*this = std::move(other);
 	}
 
-	vk::Format findDepthFormat() {
-		return findSupportedFormat(
-			{vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint},
-			vk::ImageTiling::eOptimal,
-			vk::FormatFeatureFlagBits::eDepthStencilAttachment
-		);
+	MappedFile& operator=(MappedFile&& other) noexcept {
+		if (this != &other) {
+			close();
+			std::swap(bytes, other.bytes);
+			std::swap(length, other.length);
+#ifdef _WIN32
+			std::swap(fileHandle, other.fileHandle);
+			std::swap(mappingHandle, other.mappingHandle);
+#endif
+		}
+		return *this;
 	}
 
-	bool hasStencilComponent(vk::Format format) {
-		return format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
+	~MappedFile() {
+		close();
 	}
 
-	void createTextureImage() {
-		int texWidth, texHeight, texChannels;
-		stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		vk::DeviceSize imageSize = static_cast<vk::DeviceSize>(texWidth) * static_cast<vk::DeviceSize>(texHeight) * 4;
-		mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+	bool open(const std::string& filename) {
+		close();
 
-		if (!pixels)
-			throw std::runtime_error("failed to load texture image!");
+#ifdef _WIN32
+		fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			return false;
 
-		vk::UniqueBuffer stagingBuffer;
-		vk::UniqueDeviceMemory stagingBufferMemory;
-		createBuffer(
-			imageSize, vk::BufferUsageFlagBits::eTransferSrc, 
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-			stagingBuffer, stagingBufferMemory
-		);
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+			close();
+			return false;
+		}
 
-		void* data = device->mapMemory(stagingBufferMemory.get(), 0, imageSize, vk::MemoryMapFlags());
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		device->unmapMemory(stagingBufferMemory.get());
+		mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mappingHandle) {
+			close();
+			return false;
+		}
 
-		stbi_image_free(pixels);
+		bytes = static_cast<const uint8_t*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+		if (!bytes) {
+			close();
+			return false;
+		}
+		length = static_cast<size_t>(fileSize.QuadPart);
+#else
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+			::close(fd);
+			return false;
+		}
 
-		createImage(
-			texWidth, texHeight, mipLevels, vk::SampleCountFlagBits::e1, vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
-			vk::MemoryPropertyFlagBits::eDeviceLocal, textureImage, textureImageMemory
-		);
+		void* mapping = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (mapping == MAP_FAILED)
+			return false;
 
-		transitionImageLayout(textureImage.get(), vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, mipLevels);
-		copyBufferToImage(stagingBuffer.get(), textureImage.get(), texWidth, texHeight);
-		//transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
+		bytes = static_cast<const uint8_t*>(mapping);
+		length = static_cast<size_t>(fileStat.st_size);
+#endif
 
-		generateMipmaps(textureImage.get(), vk::Format::eR8G8B8A8Unorm, texWidth, texHeight, mipLevels);
+		return true;
 	}
 
-	void generateMipmaps(vk::Image image, vk::Format imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
-		std::vector<vk::UniqueCommandBuffer> commandBuffers = beginSingleTimeCommands();
+	void close() {
+#ifdef _WIN32
+		if (bytes)
+			UnmapViewOfFile(bytes);
+		if (mappingHandle)
+			CloseHandle(mappingHandle);
+		if (fileHandle != INVALID_HANDLE_VALUE)
+			CloseHandle(fileHandle);
+		mappingHandle = nullptr;
+		fileHandle = INVALID_HANDLE_VALUE;
+#else
+		if (bytes)
+			munmap(const_cast<uint8_t*>(bytes), length);
+#endif
+		bytes = nullptr;
+		length = 0;
+	}
 
-		vk::FormatProperties formatProperties = physicalDevice.getFormatProperties(imageFormat);
-		if (!(formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear))
-			throw std::runtime_error("texture image format does not support linear blittings!");
+	bool isOpen() const {
+		return bytes != nullptr;
+	}
 
-		vk::ImageMemoryBarrier barrier = {};
-		barrier.image = image;
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
+	const uint8_t* data() const {
+		return bytes;
+	}
+
+	size_t size() const {
+		return length;
+	}
+
+private:
+	const uint8_t* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	HANDLE mappingHandle = nullptr;
+#endif
+};
+
+enum class MemoryPoolKind {
+	eBuffer,
+	eImage,
+	eTransient
+};
+
+//buffers and optimal images live in separate pools so bufferImageGranularity never has to be considered
+const size_t MEMORY_POOL_KIND_COUNT = 3;
+
+const vk::DeviceSize DEFAULT_MEMORY_BLOCK_SIZE = 64 * 1024 * 1024;
+
+struct MemoryBlock;
+
+struct MemoryAllocation {
+	vk::DeviceMemory memory;
+	vk::DeviceSize offset = 0;
+	vk::DeviceSize size = 0;
+	void* mapped = nullptr;
+	uint32_t memoryTypeIndex = 0;
+	MemoryPoolKind poolKind = MemoryPoolKind::eBuffer;
+	MemoryBlock* block = nullptr;
+};
+
+struct MemoryStats {
+	vk::DeviceSize blockBytes = 0;
+	vk::DeviceSize usedBytes = 0;
+	vk::DeviceSize freeBytes = 0;
+	vk::DeviceSize largestFreeRange = 0;
+	uint32_t blockCount = 0;
+	uint32_t allocationCount = 0;
+
+	//0 when all free space is contiguous, approaching 1 as it is split into many small ranges
+	float fragmentation() const {
+		if (freeBytes == 0)
+			return 0.0f;
+		return 1.0f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+	}
+};
+
+class DeviceMemoryAllocator;
+
+class UniqueAllocation {
+public:
+	UniqueAllocation() = default;
+	UniqueAllocation(const UniqueAllocation&) = delete;
+	UniqueAllocation& operator=(const UniqueAllocation&) = delete;
+
+	UniqueAllocation(DeviceMemoryAllocator* allocator, const MemoryAllocation& allocation)
+		: allocator(allocator), allocation(allocation) {}
+
+	UniqueAllocation(UniqueAllocation&& other) noexcept
+		: allocator(other.allocator), allocation(other.allocation) {
+		other.allocator = nullptr;
+	}
+
+	UniqueAllocation& operator=(UniqueAllocation&& other) noexcept {
+		if (this != &other) {
+			reset();
+			allocator = other.allocator;
+			allocation = other.allocation;
+			other.allocator = nullptr;
+		}
+		return *this;
+	}
+
+	~UniqueAllocation() {
+		reset();
+	}
+
+	void reset();
+
+	const MemoryAllocation& get() const {
+		return allocation;
+	}
+
+	const MemoryAllocation* operator->() const {
+		return &allocation;
+	}
+
+	explicit operator bool() const {
+		return allocator != nullptr;
+	}
+
+private:
+	DeviceMemoryAllocator* allocator = nullptr;
+	MemoryAllocation allocation;
+};
+
+struct MemoryBlock {
+	struct Range {
+		vk::DeviceSize offset;
+		vk::DeviceSize size;
+	};
+
+	vk::UniqueDeviceMemory memory;
+	vk::DeviceSize size = 0;
+	void* mapped = nullptr;
+	bool dedicated = false;
+	bool linear = false;
+	uint32_t allocationCount = 0;
+	vk::DeviceSize usedBytes = 0;
+
+	//sorted by offset, adjacent ranges are always merged
+	std::vector<Range> freeRanges;
+	//bump pointer for transient blocks, rewound once every allocation in the block is freed
+	vk::DeviceSize linearOffset = 0;
+};
+
+class DeviceMemoryAllocator {
+public:
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device) {
+		this->device = device;
+		memoryProperties = physicalDevice.getMemoryProperties();
+	}
+
+	UniqueAllocation allocate(const vk::MemoryRequirements& requirements, uint32_t memoryTypeIndex, MemoryPoolKind poolKind) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		std::vector<std::unique_ptr<MemoryBlock>>& pool = pools[memoryTypeIndex][static_cast<size_t>(poolKind)];
+		vk::DeviceSize blockSize = preferredBlockSize(memoryTypeIndex);
+		vk::DeviceSize alignment = std::max<vk::DeviceSize>(requirements.alignment, 1);
+
+		MemoryAllocation allocation;
+		allocation.memoryTypeIndex = memoryTypeIndex;
+		allocation.poolKind = poolKind;
+		allocation.size = requirements.size;
+
+		//large resources get a block of their own rather than wasting most of a shared one
+		if (requirements.size > blockSize / 2) {
+			pool.push_back(createBlock(memoryTypeIndex, requirements.size, poolKind, true));
+			allocation.block = pool.back().get();
+			allocation.offset = 0;
+		} else {
+			for (const auto& block : pool) {
+				if (block->dedicated)
+					continue;
+				if (suballocate(*block, poolKind, requirements.size, alignment, allocation.offset)) {
+					allocation.block = block.get();
+					break;
+				}
+			}
+
+			if (!allocation.block) {
+				pool.push_back(createBlock(memoryTypeIndex, blockSize, poolKind, false));
+				allocation.block = pool.back().get();
+				if (!suballocate(*allocation.block, poolKind, requirements.size, alignment, allocation.offset))
+					throw std::runtime_error("failed to sub-allocate device memory!");
+			}
+		}
+
+		allocation.block->allocationCount++;
+		allocation.block->usedBytes += allocation.size;
+		allocation.memory = allocation.block->memory.get();
+		if (allocation.block->mapped)
+			allocation.mapped = static_cast<uint8_t*>(allocation.block->mapped) + allocation.offset;
+
+		return UniqueAllocation(this, allocation);
+	}
+
+	void free(const MemoryAllocation& allocation) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		MemoryBlock& block = *allocation.block;
+		block.allocationCount--;
+		block.usedBytes -= allocation.size;
+
+		if (allocation.poolKind == MemoryPoolKind::eTransient) {
+			if (block.allocationCount == 0)
+				block.linearOffset = 0;
+		} else if (!block.dedicated) {
+			releaseRange(block, allocation.offset, allocation.size);
+		}
+
+		if (block.allocationCount > 0)
+			return;
+
+		//keep one empty shared block per pool around so that allocate/free cycles don't hit the driver
+		std::vector<std::unique_ptr<MemoryBlock>>& pool = pools[allocation.memoryTypeIndex][static_cast<size_t>(allocation.poolKind)];
+		size_t emptyBlocks = 0;
+		for (const auto& other : pool) {
+			if (other->allocationCount == 0 && !other->dedicated)
+				emptyBlocks++;
+		}
+
+		if (block.dedicated || emptyBlocks > 1) {
+			pool.erase(std::find_if(pool.begin(), pool.end(), [&](const std::unique_ptr<MemoryBlock>& other) {
+				return other.get() == &block;
+			}));
+		}
+	}
+
+	MemoryStats getStats() const {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		MemoryStats stats;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+			for (const auto& pool : pools[i])
+				accumulateStats(pool, stats);
+		}
+		return stats;
+	}
+
+	void printStats(std::ostream& out) const {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		const char* poolNames[MEMORY_POOL_KIND_COUNT] = {"buffer", "image", "transient"};
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+			for (size_t kind = 0; kind < MEMORY_POOL_KIND_COUNT; ++kind) {
+				if (pools[i][kind].empty())
+					continue;
+
+				MemoryStats stats;
+				accumulateStats(pools[i][kind], stats);
+				out << "memory type " << i << " (" << poolNames[kind] << "): "
+					<< stats.blockCount << " blocks, " << stats.allocationCount << " allocations, "
+					<< stats.usedBytes / 1024 << " / " << stats.blockBytes / 1024 << " KiB used, "
+					<< "fragmentation " << stats.fragmentation() << std::endl;
+			}
+		}
+	}
+
+private:
+	vk::Device device;
+	vk::PhysicalDeviceMemoryProperties memoryProperties;
+	std::array<std::array<std::vector<std::unique_ptr<MemoryBlock>>, MEMORY_POOL_KIND_COUNT>, VK_MAX_MEMORY_TYPES> pools;
+	mutable std::mutex mutex;
+
+	static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	vk::DeviceSize preferredBlockSize(uint32_t memoryTypeIndex) const {
+		vk::DeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+		//small heaps (e.g. the 256 MiB host visible device local heap) would be exhausted by a handful of blocks
+		return std::min(DEFAULT_MEMORY_BLOCK_SIZE, heapSize / 8);
+	}
+
+	std::unique_ptr<MemoryBlock> createBlock(uint32_t memoryTypeIndex, vk::DeviceSize size, MemoryPoolKind poolKind, bool dedicated) {
+		std::unique_ptr<MemoryBlock> block = std::make_unique<MemoryBlock>();
+		block->memory = device.allocateMemoryUnique(vk::MemoryAllocateInfo(size, memoryTypeIndex));
+		block->size = size;
+		block->dedicated = dedicated;
+		block->linear = poolKind == MemoryPoolKind::eTransient;
+		if (!dedicated && !block->linear)
+			block->freeRanges.push_back({0, size});
+
+		if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible)
+			block->mapped = device.mapMemory(block->memory.get(), 0, VK_WHOLE_SIZE, vk::MemoryMapFlags());
+
+		return block;
+	}
+
+	bool suballocate(MemoryBlock& block, MemoryPoolKind poolKind, vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize& offset) {
+		if (poolKind == MemoryPoolKind::eTransient) {
+			vk::DeviceSize alignedOffset = alignUp(block.linearOffset, alignment);
+			if (alignedOffset + size > block.size)
+				return false;
+
+			offset = alignedOffset;
+			block.linearOffset = alignedOffset + size;
+			return true;
+		}
+
+		for (size_t i = 0; i < block.freeRanges.size(); ++i) {
+			MemoryBlock::Range& range = block.freeRanges[i];
+			vk::DeviceSize alignedOffset = alignUp(range.offset, alignment);
+			vk::DeviceSize padding = alignedOffset - range.offset;
+			if (range.size < padding + size)
+				continue;
+
+			vk::DeviceSize remainder = range.size - padding - size;
+			offset = alignedOffset;
+
+			if (padding > 0 && remainder > 0) {
+				range.size = padding;
+				block.freeRanges.insert(block.freeRanges.begin() + i + 1, {alignedOffset + size, remainder});
+			} else if (padding > 0) {
+				range.size = padding;
+			} else if (remainder > 0) {
+				range.offset = alignedOffset + size;
+				range.size = remainder;
+			} else {
+				block.freeRanges.erase(block.freeRanges.begin() + i);
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+
+	void releaseRange(MemoryBlock& block, vk::DeviceSize offset, vk::DeviceSize size) {
+		auto next = std::lower_bound(block.freeRanges.begin(), block.freeRanges.end(), offset,
+			[](const MemoryBlock::Range& range, vk::DeviceSize value) {
+				return range.offset < value;
+			}
+		);
+		auto inserted = block.freeRanges.insert(next, {offset, size});
+
+		auto following = inserted + 1;
+		if (following != block.freeRanges.end() && inserted->offset + inserted->size == following->offset) {
+			inserted->size += following->size;
+			block.freeRanges.erase(following);
+		}
+
+		if (inserted != block.freeRanges.begin()) {
+			auto previous = inserted - 1;
+			if (previous->offset + previous->size == inserted->offset) {
+				previous->size += inserted->size;
+				block.freeRanges.erase(inserted);
+			}
+		}
+	}
+
+	static void accumulateStats(const std::vector<std::unique_ptr<MemoryBlock>>& pool, MemoryStats& stats) {
+		for (const auto& block : pool) {
+			stats.blockCount++;
+			stats.blockBytes += block->size;
+			stats.usedBytes += block->usedBytes;
+			stats.allocationCount += block->allocationCount;
+
+			if (block->dedicated)
+				continue;
+
+			if (block->linear) {
+				vk::DeviceSize tail = block->size - block->linearOffset;
+				stats.freeBytes += tail;
+				stats.largestFreeRange = std::max(stats.largestFreeRange, tail);
+				continue;
+			}
+
+			for (const auto& range : block->freeRanges) {
+				stats.freeBytes += range.size;
+				stats.largestFreeRange = std::max(stats.largestFreeRange, range.size);
+			}
+		}
+	}
+};
+
+inline void UniqueAllocation::reset() {
+	if (allocator)
+		allocator->free(allocation);
+	allocator = nullptr;
+}
+
+//timed regions of every frame's primary command buffer, each one owns a begin and an end timestamp query
+enum class GpuScope : uint32_t {
+	eFrame,
+	eCulling,
+	eRenderPass,
+	eCount
+};
+
+const uint32_t GPU_SCOPE_COUNT = static_cast<uint32_t>(GpuScope::eCount);
+const char* const GPU_SCOPE_NAMES[GPU_SCOPE_COUNT] = {"frame", "culling", "render pass"};
+
+//left out of the benchmark statistics, they are dominated by first use costs
+const uint32_t BENCHMARK_WARMUP_FRAMES = 10;
+
+//how the time from a present call to the image reaching the display is measured, if at all
+enum class PresentTiming {
+	eNone,
+	eDisplayTiming,
+	ePresentWait
+};
+
+//presents that were dropped or never reported stop being waited for after this many
+const size_t PENDING_PRESENT_LIMIT = 64;
+
+struct FrameProfile {
+	uint64_t frameNumber = 0;
+	double cpuFrameMs = 0.0;
+	double fenceWaitMs = 0.0;
+	double acquireMs = 0.0;
+	double presentMs = 0.0;
+	bool gpuTimesValid = false;
+	double gpuScopeMs[GPU_SCOPE_COUNT] = {};
+	bool statisticsValid = false;
+	uint64_t vertexInvocations = 0;
+	uint64_t fragmentInvocations = 0;
+};
+
+double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//one frame's copy of the offscreen image, read straight out of the mapping by the worker that encodes it
+struct ReadbackBuffer {
+	vk::UniqueBuffer buffer;
+	UniqueAllocation memory;
+	//the frame copied into it, 0 once it has been handed to a worker or if it never held one
+	uint64_t frameNumber = 0;
+	//the buffer isn't copied into again until this is done
+	std::future<void> write;
+};
+
+//readback buffers per frame in flight, the second set is what the workers encode while the gpu fills the first
+const uint32_t READBACK_BUFFERS_PER_FRAME = 2;
+
+struct WorkerCommandPool {
+	vk::UniqueCommandPool pool;
+	std::vector<vk::UniqueCommandBuffer> secondaryCommandBuffers;
+	size_t usedCommandBuffers = 0;
+};
+
+struct UploadBatch {
+	vk::UniqueCommandBuffer transferCommands;
+	//ownership acquires and mipmap blits, only used when the transfer family differs from the graphics family
+	vk::UniqueCommandBuffer graphicsCommands;
+	vk::UniqueSemaphore transferComplete;
+	vk::UniqueFence fence;
+	std::vector<vk::UniqueBuffer> stagingBuffers;
+	std::vector<UniqueAllocation> stagingMemory;
+	//run from retireUploads() once the batch's fence has signalled
+	std::vector<std::function<void()>> completionCallbacks;
+};
+
+//64-bit FNV-1a
+uint64_t hashBytes(const uint8_t* data, size_t size) {
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+struct TextureLevel {
+	size_t offset;
+	size_t size;
+	uint32_t width;
+	uint32_t height;
+};
+
+//either a mapped KTX2/DDS container whose levels point into the mapping, or a decoded RGBA8 image with a single level
+struct TextureData {
+	vk::Format format = vk::Format::eUndefined;
+	std::vector<TextureLevel> levels;
+	MappedFile container;
+	std::vector<uint8_t> pixels;
+
+	const uint8_t* data() const {
+		return container.isOpen() ? container.data() : pixels.data();
+	}
+};
+
+//box filters a decoded RGBA8 image all the way down to 1x1, appending every level to its pixels.
+//streaming needs the whole chain on the cpu, so it can't be blitted on the gpu like it is otherwise
+void generateMipChain(TextureData& texture) {
+	texture.pixels.reserve(texture.pixels.size() * 4 / 3 + 64);
+
+	while (texture.levels.back().width > 1 || texture.levels.back().height > 1) {
+		TextureLevel source = texture.levels.back();
+		TextureLevel level;
+		level.width = std::max(source.width / 2, 1u);
+		level.height = std::max(source.height / 2, 1u);
+		level.offset = texture.pixels.size();
+		level.size = static_cast<size_t>(level.width) * level.height * 4;
+		texture.pixels.resize(level.offset + level.size);
+
+		const uint8_t* src = texture.pixels.data() + source.offset;
+		uint8_t* dst = texture.pixels.data() + level.offset;
+		for (uint32_t y = 0; y < level.height; ++y) {
+			size_t row0 = std::min(y * 2, source.height - 1) * static_cast<size_t>(source.width);
+			size_t row1 = std::min(y * 2 + 1, source.height - 1) * static_cast<size_t>(source.width);
+			for (uint32_t x = 0; x < level.width; ++x) {
+				size_t column0 = std::min(x * 2, source.width - 1);
+				size_t column1 = std::min(x * 2 + 1, source.width - 1);
+				for (size_t c = 0; c < 4; ++c) {
+					uint32_t sum = src[(row0 + column0) * 4 + c] + src[(row0 + column1) * 4 + c] +
+						src[(row1 + column0) * 4 + c] + src[(row1 + column1) * 4 + c];
+					dst[(static_cast<size_t>(y) * level.width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+				}
+			}
+		}
+
+		texture.levels.push_back(level);
+	}
+}
+
+//one residency of a streamed texture, levels baseLevel and up of the full chain.
+//declared in this order so the view goes before the image and the image before its memory
+struct StreamedTextureImage {
+	UniqueAllocation memory;
+	vk::UniqueImage image;
+	vk::UniqueImageView view;
+	uint32_t baseLevel = 0;
+	//the bindless array slot its view was written to, given back once the image is retired
+	uint32_t bindlessSlot = 0;
+};
+
+//levels no larger than this are the mip tail, uploaded at startup and never evicted
+const uint32_t TEXTURE_STREAMING_TAIL_SIZE = 128;
+
+template<typename T>
+T readValue(const uint8_t* data, size_t offset) {
+	T value;
+	memcpy(&value, data + offset, sizeof(T));
+	return value;
+}
+
+//floor(log2(max(width, height))) + 1, the length of a full mip chain. a file claiming more levels is malformed
+uint32_t fullMipLevelCount(uint32_t width, uint32_t height) {
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+		++levels;
+	return levels;
+}
+
+const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+const size_t KTX2_HEADER_SIZE = 80;
+const size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+//only plain 2D textures without supercompression, anything else is reported as unsupported
+bool parseKtx2(const MappedFile& file, TextureData& texture) {
+	const uint8_t* data = file.data();
+	if (file.size() < KTX2_HEADER_SIZE || memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+		return false;
+
+	uint32_t format = readValue<uint32_t>(data, 12);
+	uint32_t width = readValue<uint32_t>(data, 20);
+	uint32_t height = readValue<uint32_t>(data, 24);
+	uint32_t depth = readValue<uint32_t>(data, 28);
+	uint32_t layerCount = readValue<uint32_t>(data, 32);
+	uint32_t faceCount = readValue<uint32_t>(data, 36);
+	uint32_t levelCount = std::max(readValue<uint32_t>(data, 40), 1u);
+	uint32_t supercompressionScheme = readValue<uint32_t>(data, 44);
+
+	if (depth > 1 || layerCount > 1 || faceCount != 1 || supercompressionScheme != 0 || width == 0 || height == 0)
+		return false;
+	if (levelCount > fullMipLevelCount(width, height))
+		return false;
+	if (file.size() < KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE)
+		return false;
+
+	texture.format = static_cast<vk::Format>(format);
+	texture.levels.clear();
+	for (uint32_t i = 0; i < levelCount; ++i) {
+		size_t entry = KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+		uint64_t offset = readValue<uint64_t>(data, entry);
+		uint64_t size = readValue<uint64_t>(data, entry + 8);
+		if (size == 0 || offset > file.size() || size > file.size() - offset)
+			return false;
+
+		texture.levels.push_back({
+			static_cast<size_t>(offset), static_cast<size_t>(size), std::max(width >> i, 1u), std::max(height >> i, 1u)
+		});
+	}
+
+	return true;
+}
+
+//maps the block compressed DXGI formats, both from a DX10 header and from the legacy FourCC codes
+vk::Format ddsFormat(uint32_t fourCC, uint32_t dxgiFormat) {
+	auto makeFourCC = [](char a, char b, char c, char d) {
+		return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 | static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+	};
+
+	if (fourCC == makeFourCC('D', 'X', 'T', '1'))
+		return vk::Format::eBc1RgbaUnormBlock;
+	if (fourCC == makeFourCC('D', 'X', 'T', '5'))
+		return vk::Format::eBc3UnormBlock;
+	if (fourCC == makeFourCC('A', 'T', 'I', '2') || fourCC == makeFourCC('B', 'C', '5', 'U'))
+		return vk::Format::eBc5UnormBlock;
+	if (fourCC != makeFourCC('D', 'X', '1', '0'))
+		return vk::Format::eUndefined;
+
+	switch (dxgiFormat) {
+	case 71: return vk::Format::eBc1RgbaUnormBlock;
+	case 72: return vk::Format::eBc1RgbaSrgbBlock;
+	case 77: return vk::Format::eBc3UnormBlock;
+	case 78: return vk::Format::eBc3SrgbBlock;
+	case 80: return vk::Format::eBc4UnormBlock;
+	case 83: return vk::Format::eBc5UnormBlock;
+	case 98: return vk::Format::eBc7UnormBlock;
+	case 99: return vk::Format::eBc7SrgbBlock;
+	default: return vk::Format::eUndefined;
+	}
+}
+
+const size_t DDS_HEADER_SIZE = 128;
+const size_t DDS_DX10_HEADER_SIZE = 20;
+
+//DDS has no level index, the levels of a block compressed texture are packed back to back after the headers
+bool parseDds(const MappedFile& file, TextureData& texture) {
+	const uint8_t* data = file.data();
+	if (file.size() < DDS_HEADER_SIZE || memcmp(data, "DDS ", 4) != 0)
+		return false;
+
+	uint32_t height = readValue<uint32_t>(data, 12);
+	uint32_t width = readValue<uint32_t>(data, 16);
+	uint32_t levelCount = std::max(readValue<uint32_t>(data, 28), 1u);
+	uint32_t fourCC = readValue<uint32_t>(data, 84);
+
+	size_t offset = DDS_HEADER_SIZE;
+	uint32_t dxgiFormat = 0;
+	if (fourCC == readValue<uint32_t>(reinterpret_cast<const uint8_t*>("DX10"), 0)) {
+		if (file.size() < DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE)
+			return false;
+		dxgiFormat = readValue<uint32_t>(data, DDS_HEADER_SIZE);
+		offset += DDS_DX10_HEADER_SIZE;
+	}
+
+	texture.format = ddsFormat(fourCC, dxgiFormat);
+	if (texture.format == vk::Format::eUndefined || width == 0 || height == 0)
+		return false;
+	if (levelCount > fullMipLevelCount(width, height))
+		return false;
+
+	bool smallBlocks = texture.format == vk::Format::eBc1RgbaUnormBlock || texture.format == vk::Format::eBc1RgbaSrgbBlock ||
+		texture.format == vk::Format::eBc4UnormBlock;
+	size_t blockSize = smallBlocks ? 8 : 16;
+
+	texture.levels.clear();
+	for (uint32_t i = 0; i < levelCount; ++i) {
+		uint32_t levelWidth = std::max(width >> i, 1u);
+		uint32_t levelHeight = std::max(height >> i, 1u);
+		size_t size = static_cast<size_t>((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockSize;
+		if (offset + size > file.size())
+			return false;
+
+		texture.levels.push_back({offset, size, levelWidth, levelHeight});
+		offset += size;
+	}
+
+	return true;
+}
+
+class HelloTriangleApplication {
+public:
+	explicit HelloTriangleApplication(const ApplicationOptions& options) : options(options) {}
+
+	void run() {
+		initWindow();
+		initVulkan();
+		mainLoop();
+		cleanup();
+	}
+
+private:
+	ApplicationOptions options;
+
+	SDL_Window* window = nullptr;
+	SDL_Event event;
+	bool quitting = false;
+	bool framebufferResized = false;
+
+	vk::UniqueInstance instance;
+	//the version the instance was created with, see createInstance
+	uint32_t instanceApiVersion = VK_API_VERSION_1_0;
+	vk::UniqueDebugUtilsMessengerEXT debugMessenger;
+	vk::UniqueSurfaceKHR surface;
+
+	vk::PhysicalDevice physicalDevice;
+	vk::SampleCountFlagBits msaaSamples = vk::SampleCountFlagBits::e1;
+	vk::UniqueDevice device;
+	DeviceMemoryAllocator allocator;
+
+	vk::Queue graphicsQueue;
+	vk::Queue presentQueue;
+	vk::Queue transferQueue;
+	uint32_t graphicsQueueFamily = 0;
+	uint32_t transferQueueFamily = 0;
+
+	//--device-group, each frame is rendered and presented by one device of the group in turn.
+	//uploads leave their device masks at the default and so run on every device
+	std::vector<vk::PhysicalDevice> deviceGroupDevices;
+	uint32_t alternateFrameDevices = 1;
+	uint32_t frameDeviceMask = 1;
+
+	vk::UniqueSwapchainKHR swapchain;
+	//kept alive for a few frames after recreation since presents from it may still be queued
+	vk::UniqueSwapchainKHR retiredSwapchain;
+	size_t framesSinceSwapchainRetired = 0;
+	std::vector<vk::Image> swapchainImages;
+
+	//present ids are frame numbers, the call time is on steady_clock so that display timing results can be compared with it
+	PresentTiming presentTiming = PresentTiming::eNone;
+	std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point>> pendingPresents;
+	std::vector<double> recentPresentLatencies;
+	std::vector<double> benchmarkPresentLatencies;
+#ifdef VK_KHR_present_wait
+	PFN_vkWaitForPresentKHR waitForPresentKHR = nullptr;
+#endif
+
+	//--fps-limit sleeps until the deadline at the start of each frame
+	std::chrono::steady_clock::duration frameInterval = std::chrono::steady_clock::duration::zero();
+	std::chrono::steady_clock::time_point nextFrameDeadline;
+	vk::Format swapchainImageFormat;
+	vk::Extent2D swapchainExtent;
+	std::vector<vk::UniqueImageView> swapchainImageViews;
+	std::vector<vk::UniqueFramebuffer> swapchainFramebuffers;
+
+	//take the place of the swapchain images with --offscreen, one per frame in flight so a frame never renders over one still being read back
+	std::vector<vk::UniqueImage> offscreenImages;
+	std::vector<UniqueAllocation> offscreenImageMemory;
+	std::vector<ReadbackBuffer> readbackBuffers;
+
+	vk::UniqueRenderPass renderPass;
+	vk::UniqueDescriptorSetLayout descriptorSetLayout;
+	vk::UniquePipelineLayout pipelineLayout;
+	vk::UniquePipelineCache pipelineCache;
+	//keyed by hashPipelineVariant(), filled by buildPipelineVariants() and added to by getGraphicsPipeline() on a miss
+	struct GraphicsShaderCode {
+		std::vector<char> vertex;
+		std::vector<char> fragment;
+	};
+
+	std::unordered_map<uint64_t, vk::UniquePipeline> graphicsPipelines;
+	std::mutex graphicsPipelinesMutex;
+	GraphicsShaderCode graphicsShaderCode;
+
+	//--hot-reload, changed sources are compiled and their pipelines rebuilt on a worker while the old ones keep rendering
+	struct WatchedShader {
+		std::string path;
+		std::filesystem::file_time_type modifiedTime;
+		bool culling;
+	};
+
+	struct ShaderReload {
+		bool graphicsChanged = false;
+		GraphicsShaderCode graphicsShaderCode;
+		std::unordered_map<uint64_t, vk::UniquePipeline> graphicsPipelines;
+		vk::UniquePipeline cullPipeline;
+	};
+
+	bool hotReload = false;
+	std::vector<WatchedShader> watchedShaders;
+	std::chrono::high_resolution_clock::time_point lastShaderPoll;
+	std::future<ShaderReload> shaderReload;
+	//replaced pipelines stay alive until the frames that might still use them have finished
+	std::vector<vk::UniquePipeline> retiredPipelines;
+	size_t framesSincePipelinesRetired = 0;
+
+	//one pool per frame in flight for the primary, plus one per worker thread per frame for secondaries
+	std::vector<vk::UniqueCommandPool> frameCommandPools;
+	std::vector<std::vector<WorkerCommandPool>> workerCommandPools;
+
+	vk::UniqueCommandPool transferCommandPool;
+	vk::UniqueCommandPool uploadCommandPool;
+	std::unique_ptr<UploadBatch> uploadBatch;
+	std::vector<std::unique_ptr<UploadBatch>> pendingUploads;
+
+	vk::UniqueImage colorImage;
+	UniqueAllocation colorImageMemory;
+	vk::UniqueImageView colorImageView;
+
+	vk::UniqueImage depthImage;
+	UniqueAllocation depthImageMemory;
+	vk::UniqueImageView depthImageView;
+	vk::Format depthFormat = vk::Format::eUndefined;
+
+	//--dynamic-rendering, the attachment layout transitions are synchronization2 barriers around each frame's rendering.
+	//both extensions are newer than the headers this was written against, so they only exist when the headers have them
+	bool dynamicRendering = false;
+#ifdef VK_KHR_dynamic_rendering
+	PFN_vkCmdBeginRenderingKHR cmdBeginRenderingKHR = nullptr;
+	PFN_vkCmdEndRenderingKHR cmdEndRenderingKHR = nullptr;
+	PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2KHR = nullptr;
+#endif
+
+	uint32_t mipLevels;
+	vk::Format textureFormat = vk::Format::eR8G8B8A8Unorm;
+	vk::UniqueImage textureImage;
+	UniqueAllocation textureImageMemory;
+	vk::UniqueImageView textureImageView;
+	vk::UniqueSampler textureSampler;
+
+	//--stream-textures keeps every level on the cpu and swaps in a differently sized image whenever the resident levels change.
+	//the swap rewrites the spare descriptor set, so it waits until the frames that used it before the last swap are done
+	bool textureStreaming = false;
+	bool memoryBudget = false;
+	TextureData streamingSource;
+	uint32_t textureLevelCount = 1;
+	uint32_t textureBaseLevel = 0;
+	uint32_t textureTailLevel = 0;
+	float textureDemandPixels = 0.0f;
+	std::unique_ptr<StreamedTextureImage> streamingTexture;
+	bool streamingTextureUploaded = false;
+	std::vector<StreamedTextureImage> retiredTextures;
+	size_t framesSinceTextureSwap = 0;
+	vk::DescriptorSet spareDescriptorSet;
+
+	MappedFile modelCacheFile;
+
+	//--stream-mesh keeps only the OBJ's attributes in memory, its faces are read from the mapping once the device exists
+	MappedFile streamedModelFile;
+	std::vector<glm::vec3> streamedPositions;
+	std::vector<glm::vec2> streamedTexCoords;
+	uint64_t streamedTriangleCount = 0;
+	glm::vec3 streamedMinPosition = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 streamedMaxPosition = glm::vec3(-std::numeric_limits<float>::max());
+	glm::vec2 streamedMinTexCoord = glm::vec2(std::numeric_limits<float>::max());
+	glm::vec2 streamedMaxTexCoord = glm::vec2(-std::numeric_limits<float>::max());
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	const Vertex* vertexData = nullptr;
+	const uint32_t* indexData = nullptr;
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	std::vector<Submesh> submeshes;
+	uint32_t lodCount = 1;
+	//takes the packed vertex buffer's positions back to model space, applied in the vertex shader
+	VertexFormat vertexFormat = VertexFormat::eFull;
+	glm::vec3 positionOffset = glm::vec3(0.0f);
+	glm::vec3 positionScale = glm::vec3(1.0f);
+	glm::vec4 texCoordTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+
+	vk::UniqueBuffer vertexBuffer;
+	UniqueAllocation vertexBufferMemory;
+	vk::UniqueBuffer indexBuffer;
+	UniqueAllocation indexBufferMemory;
+
+	vk::UniqueBuffer uniformBuffer;
+	UniqueAllocation uniformBufferMemory;
+	vk::DeviceSize uniformBufferStride = 0;
+
+	//rewritten every frame like the uniform buffer, one slice of instanceCount transforms per frame in flight
+	vk::UniqueBuffer instanceBuffer;
+	UniqueAllocation instanceBufferMemory;
+	vk::DeviceSize instanceSliceStride = 0;
+	uint32_t instanceCount = 1;
+	float meshRadius = 1.0f;
+
+	//without gpu culling the instances are sorted by lod on the cpu, lod i draws instances lodFirstInstance[i] to lodFirstInstance[i + 1]
+	float lodDistance = 1.0f;
+	std::vector<uint32_t> lodFirstInstance;
+	std::vector<glm::mat4> unsortedInstances;
+	std::vector<uint32_t> instanceLods;
+
+	//--gpu-culling, every frame in flight owns a slice of cullBuffer laid out as:
+	//draw count, visible instance count per lod, one draw command per submesh, instanceCount visible instance transforms per lod
+	bool gpuCulling = false;
+	bool multiDrawIndirect = false;
+	//the lod buckets are drawn with a non-zero firstInstance, so only lod 0 is used without drawIndirectFirstInstance
+	bool drawIndirectFirstInstance = false;
+	uint32_t cullLodCount = 1;
+	PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCountKHR = nullptr;
+	std::array<glm::vec4, 6> frustumPlanes;
+	vk::UniqueBuffer cullBuffer;
+	UniqueAllocation cullBufferMemory;
+	vk::DeviceSize cullSliceStride = 0;
+	vk::DeviceSize cullVisibleCountOffset = 0;
+	vk::DeviceSize cullCommandsOffset = 0;
+	vk::DeviceSize cullVisibleInstancesOffset = 0;
+	uint32_t cullDrawCapacity = 0;
+	vk::UniqueBuffer submeshBuffer;
+	UniqueAllocation submeshBufferMemory;
+	vk::UniqueDescriptorSetLayout cullDescriptorSetLayout;
+	vk::UniquePipelineLayout cullPipelineLayout;
+	vk::UniquePipeline cullPipeline;
+	vk::UniqueDescriptorPool cullDescriptorPool;
+	std::vector<vk::DescriptorSet> cullDescriptorSets;
+
+	vk::UniqueDescriptorPool descriptorPool;
+	vk::DescriptorSet descriptorSet;
+
+	//--bindless, set 1 holds one sampler and a partially bound array of sampled images.
+	//slots of retired streamed textures are reused, anything else only ever grows the array
+	bool bindless = false;
+	bool bindlessUpdateAfterBind = false;
+	bool bindlessUpdateUnusedWhilePending = false;
+	uint32_t bindlessTextureCapacity = 0;
+	uint32_t bindlessTextureCount = 0;
+	std::vector<uint32_t> freeBindlessTextureSlots;
+	uint32_t modelTextureIndex = 0;
+	vk::UniqueDescriptorSetLayout bindlessDescriptorSetLayout;
+	vk::UniqueDescriptorPool bindlessDescriptorPool;
+	vk::DescriptorSet bindlessDescriptorSet;
+
+	std::vector<vk::UniqueCommandBuffer> commandBuffers;
+
+	std::vector<vk::UniqueSemaphore> imageAvailableSemaphores;
+	std::vector<vk::UniqueSemaphore> renderFinishedSemaphores;
+	std::vector<vk::UniqueFence> inFlightFences;
+	//number of the last frame that rendered to each swapchain image, 0 if none has yet
+	std::vector<uint64_t> imagesInFlight;
+	//number of the frame last submitted from each slot, frames are numbered from 1 so they can double as timeline values
+	std::vector<uint64_t> frameSlotNumbers;
+	uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT;
+	uint32_t maxLatency = DEFAULT_FRAMES_IN_FLIGHT;
+	size_t currentFrame = 0;
+
+	//replaces the fences while set, signalled with the frame number by every frame's submit
+	vk::UniqueSemaphore frameTimeline;
+	uint64_t completedFrameNumber = 0;
+#ifdef VK_KHR_timeline_semaphore
+	PFN_vkWaitSemaphoresKHR waitSemaphoresKHR = nullptr;
+#endif
+
+	//a frame's queries are read back when its slot is next waited on, so results lag framesInFlight frames behind
+	bool profiling = false;
+	bool timestampQueries = false;
+	bool statisticsQueries = false;
+	double timestampPeriod = 1.0;
+	uint64_t timestampMask = ~0ull;
+	std::vector<vk::UniqueQueryPool> timestampQueryPools;
+	std::vector<vk::UniqueQueryPool> statisticsQueryPools;
+	std::vector<FrameProfile> frameProfiles;
+	std::vector<bool> frameQueriesWritten;
+	uint64_t frameNumber = 0;
+	std::chrono::high_resolution_clock::time_point lastFrameStart;
+	std::vector<FrameProfile> profileSummary;
+	std::chrono::high_resolution_clock::time_point lastProfileSummary;
+	std::ofstream profileCsv;
+
+	std::vector<std::pair<const char*, double>> startupTimings;
+
+	//loaded while tracing when the instance has VK_EXT_debug_utils, so captures carry the same names as the cpu trace
+	bool debugLabels = false;
+	PFN_vkCmdBeginDebugUtilsLabelEXT cmdBeginDebugUtilsLabelEXT = nullptr;
+	PFN_vkCmdEndDebugUtilsLabelEXT cmdEndDebugUtilsLabelEXT = nullptr;
+	PFN_vkQueueInsertDebugUtilsLabelEXT queueInsertDebugUtilsLabelEXT = nullptr;
+	std::vector<FrameProfile> benchmarkProfiles;
+
+	//asset loads run on the workers while the device and pipelines are created
+	std::future<void> modelLoad;
+	std::future<TextureData> textureLoad;
+
+	//declared last so the workers are joined before anything they might touch is destroyed
+	std::unique_ptr<ThreadPool> workers;
+
+	void initWindow() {
+		if (options.offscreen)
+			return;
+
+		if (SDL_Init(SDL_INIT_VIDEO) < 0)
+			throw std::runtime_error("failed to initialise SDL!");
+
+		window = SDL_CreateWindow("Vulkan", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WIDTH, HEIGHT, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+		if (!window)
+			throw std::runtime_error("failed to create window!");
+	}
+
+	void initVulkan() {
+		//enabled before the workers start so theirs are named from the beginning
+		if (!options.tracePath.empty()) {
+			CpuProfiler::enable();
+			CpuProfiler::nameThread("main");
+		}
+
+		uint32_t workerThreads = options.workerThreads;
+		if (workerThreads == 0)
+			workerThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		workers = std::make_unique<ThreadPool>(workerThreads);
+		profiling = options.profile || !options.profileCsvPath.empty() || options.benchmarkFrames > 0;
+		framesInFlight = options.framesInFlight;
+		hotReload = options.hotReload;
+		textureStreaming = options.streamTextures;
+		maxLatency = options.maxLatency == 0 ? framesInFlight : std::min(options.maxLatency, framesInFlight);
+		if (options.fpsLimit > 0)
+			frameInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / options.fpsLimit));
+
+		using Stage = void (HelloTriangleApplication::*)();
+		const std::pair<const char*, Stage> stages[] = {
+			{"startModelLoad", &HelloTriangleApplication::startModelLoad},
+			{"createInstance", &HelloTriangleApplication::createInstance},
+			{"setupDebugMessenger", &HelloTriangleApplication::setupDebugMessenger},
+			{"createSurface", &HelloTriangleApplication::createSurface},
+			{"pickPhysicalDevice", &HelloTriangleApplication::pickPhysicalDevice},
+			{"startTextureLoad", &HelloTriangleApplication::startTextureLoad},
+			{"createLogicalDevice", &HelloTriangleApplication::createLogicalDevice},
+			{"chooseVertexFormat", &HelloTriangleApplication::chooseVertexFormat},
+			{"createPipelineCache", &HelloTriangleApplication::createPipelineCache},
+			{"createSwapchain", &HelloTriangleApplication::createSwapchain},
+			{"createImageViews", &HelloTriangleApplication::createImageViews},
+			{"createRenderPass", &HelloTriangleApplication::createRenderPass},
+			{"createDescriptorSetLayout", &HelloTriangleApplication::createDescriptorSetLayout},
+			{"createGraphicsPipeline", &HelloTriangleApplication::createGraphicsPipeline},
+			{"createCommandPools", &HelloTriangleApplication::createCommandPools},
+			{"createQueryPools", &HelloTriangleApplication::createQueryPools},
+			{"createUploadCommandPools", &HelloTriangleApplication::createUploadCommandPools},
+			{"createColorResources", &HelloTriangleApplication::createColorResources},
+			{"createDepthResources", &HelloTriangleApplication::createDepthResources},
+			{"createFramebuffers", &HelloTriangleApplication::createFramebuffers},
+			{"createTextureImage", &HelloTriangleApplication::createTextureImage},
+			{"createTextureImageView", &HelloTriangleApplication::createTextureImageView},
+			{"createTextureSampler", &HelloTriangleApplication::createTextureSampler},
+			{"waitForModel", &HelloTriangleApplication::waitForModel},
+			{"createVertexBuffer", &HelloTriangleApplication::createVertexBuffer},
+			{"createIndexBuffer", &HelloTriangleApplication::createIndexBuffer},
+			{"submitUploads", &HelloTriangleApplication::submitUploads},
+			{"createUniformBuffers", &HelloTriangleApplication::createUniformBuffers},
+			{"createDescriptorPool", &HelloTriangleApplication::createDescriptorPool},
+			{"createDescriptorSets", &HelloTriangleApplication::createDescriptorSets},
+			{"createCullingResources", &HelloTriangleApplication::createCullingResources},
+			{"createCommandBuffers", &HelloTriangleApplication::createCommandBuffers},
+			{"createSyncObjects", &HelloTriangleApplication::createSyncObjects},
+			{"createReadbackBuffers", &HelloTriangleApplication::createReadbackBuffers},
+		};
+
+		for (const auto& stage : stages) {
+			CpuScope scope(stage.first);
+			auto start = std::chrono::high_resolution_clock::now();
+			(this->*stage.second)();
+			startupTimings.emplace_back(stage.first, millisecondsSince(start));
+		}
+	}
+
+	void mainLoop() {
+		while (!quitting) {
+			while (window && SDL_PollEvent(&event) != 0) {
+				if (event.type == SDL_QUIT) {
+					quitting = true;
+				}
+				if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_RESIZED) {
+					framebufferResized = true;
+				}
+			}
+			pollShaderChanges();
+			drawFrame();
+
+			if (options.benchmarkFrames > 0 && frameNumber >= options.benchmarkFrames)
+				quitting = true;
+			if (options.frameCount > 0 && frameNumber >= options.frameCount)
+				quitting = true;
+		}
+
+		//a reload still running on a worker would otherwise outlive the device
+		if (shaderReload.valid())
+			shaderReload.wait();
+		device->waitIdle();
+
+		//every frame is done, so whatever is still in the readback buffers can be written out
+		collectReadbacks(frameNumber);
+		for (auto& readback : readbackBuffers) {
+			if (readback.write.valid())
+				readback.write.get();
+		}
+
+		if (options.benchmarkFrames > 0) {
+			//every frame has finished now, so the last frames' queries can be picked up too
+			for (size_t i = 0; i < framesInFlight; ++i)
+				collectFrameProfile((currentFrame + i) % framesInFlight);
+			printBenchmarkReport();
+		}
+	}
+
+	static void printFrameTimeStatistics(const char* name, std::vector<double> times) {
+		if (times.empty())
+			return;
+
+		std::sort(times.begin(), times.end());
+		double total = 0.0;
+		for (double time : times)
+			total += time;
+
+		size_t p99 = std::min(times.size() - 1, static_cast<size_t>(std::ceil(times.size() * 0.99)) - 1);
+		std::cout << "  " << name << ": min " << times.front() << " ms, avg " << total / times.size()
+			<< " ms, p99 " << times[p99] << " ms, max " << times.back() << " ms" << std::endl;
+	}
+
+	void printBenchmarkReport() {
+		std::cout.setf(std::ios::fixed);
+		std::cout.precision(3);
+
+		double startupTotal = 0.0;
+		std::cout << "startup:" << std::endl;
+		for (const auto& timing : startupTimings) {
+			std::cout << "  " << timing.first << ": " << timing.second << " ms" << std::endl;
+			startupTotal += timing.second;
+		}
+		std::cout << "  total: " << startupTotal << " ms" << std::endl;
+
+		std::vector<double> cpuTimes, gpuTimes, fenceTimes, acquireTimes, presentTimes;
+		for (const auto& profile : benchmarkProfiles) {
+			if (benchmarkProfiles.size() > BENCHMARK_WARMUP_FRAMES && profile.frameNumber < BENCHMARK_WARMUP_FRAMES)
+				continue;
+
+			//the first frame has no previous frame to measure against
+			if (profile.frameNumber > 0)
+				cpuTimes.push_back(profile.cpuFrameMs);
+			if (profile.gpuTimesValid)
+				gpuTimes.push_back(profile.gpuScopeMs[static_cast<uint32_t>(GpuScope::eFrame)]);
+			fenceTimes.push_back(profile.fenceWaitMs);
+			acquireTimes.push_back(profile.acquireMs);
+			presentTimes.push_back(profile.presentMs);
+		}
+
+		std::cout << "frames: " << frameNumber << " (" << cpuTimes.size() << " measured)" << std::endl;
+		printFrameTimeStatistics("cpu frame", cpuTimes);
+		printFrameTimeStatistics("gpu frame", gpuTimes);
+		printFrameTimeStatistics("fence wait", fenceTimes);
+		if (!options.offscreen) {
+			printFrameTimeStatistics("acquire", acquireTimes);
+			printFrameTimeStatistics("present", presentTimes);
+			printFrameTimeStatistics(getPresentLatencyLabel(), benchmarkPresentLatencies);
+		}
+
+		MemoryStats memory = allocator.getStats();
+		std::cout << "memory: " << memory.usedBytes / 1024 << " / " << memory.blockBytes / 1024 << " KiB used in "
+			<< memory.blockCount << " blocks, " << memory.allocationCount << " allocations, fragmentation "
+			<< memory.fragmentation() << std::endl;
+		allocator.printStats(std::cout);
+	}
+
+	void cleanup() {
+		savePipelineCache();
+
+		if (!options.tracePath.empty())
+			CpuProfiler::writeChromeTrace(options.tracePath);
+
+		if (enableValidationLayers)
+			allocator.printStats(std::cout);
+
+		if (window) {
+			SDL_DestroyWindow(window);
+			SDL_Quit();
+		}
+	}
+
+	void createInstance() {
+		if (enableValidationLayers && !checkValidationLayerSupport())
+			throw std::runtime_error("validation layers requested, but not available!");
+
+		//1.1 is asked for whenever the loader has it, the basic renderer only needs 1.0 and every feature that relies on
+		//1.1 entry points checks supportsVulkan11 first. a 1.0 loader has no vkEnumerateInstanceVersion and rejects 1.1
+		auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+		instanceApiVersion = VK_API_VERSION_1_0;
+		if (enumerateInstanceVersion && enumerateInstanceVersion(&instanceApiVersion) != VK_SUCCESS)
+			instanceApiVersion = VK_API_VERSION_1_0;
+
+		vk::ApplicationInfo applicationInfo(
+			"Hello Triangle", VK_MAKE_VERSION(1, 0, 0),
+			"No Engine", VK_MAKE_VERSION(1, 0, 0),
+			instanceApiVersion >= VK_API_VERSION_1_1 ? VK_API_VERSION_1_1 : VK_API_VERSION_1_0
+		);
+
+		std::vector<const char*> extensions = getRequiredExtensions();
+
+		size_t layerCount = 0;
+		if (enableValidationLayers)
+			layerCount = validationLayers.size();
+
+		vk::DebugUtilsMessengerCreateInfoEXT debugMessengerCreateInfo = getDebugUtilsMessengerCreateInfo();
+		vk::InstanceCreateInfo instanceCreateInfo(
+			{}, &applicationInfo,
+			static_cast<uint32_t>(layerCount), validationLayers.data(),
+			static_cast<uint32_t>(extensions.size()), extensions.data()
+		);
+		instanceCreateInfo.pNext = &debugMessengerCreateInfo;
+
+		instance = vk::createInstanceUnique(
+			instanceCreateInfo
+		);
+	}
+
+	vk::DebugUtilsMessengerCreateInfoEXT getDebugUtilsMessengerCreateInfo() {
+		return vk::DebugUtilsMessengerCreateInfoEXT(
+			{},
+			vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose | vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning | vk::DebugUtilsMessageSeverityFlagBitsEXT::eError,
+			vk::DebugUtilsMessageTypeFlagBitsEXT::eGeneral | vk::DebugUtilsMessageTypeFlagBitsEXT::eValidation | vk::DebugUtilsMessageTypeFlagBitsEXT::ePerformance,
+			&debugCallback
+		);
+	}
+
+	void setupDebugMessenger() {
+		if (debugLabels) {
+			cmdBeginDebugUtilsLabelEXT = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(instance->getProcAddr("vkCmdBeginDebugUtilsLabelEXT"));
+			cmdEndDebugUtilsLabelEXT = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(instance->getProcAddr("vkCmdEndDebugUtilsLabelEXT"));
+			queueInsertDebugUtilsLabelEXT = reinterpret_cast<PFN_vkQueueInsertDebugUtilsLabelEXT>(instance->getProcAddr("vkQueueInsertDebugUtilsLabelEXT"));
+			debugLabels = cmdBeginDebugUtilsLabelEXT && cmdEndDebugUtilsLabelEXT && queueInsertDebugUtilsLabelEXT;
+		}
+
+		if (!enableValidationLayers)
+			return;
+
+		debugMessenger = instance->createDebugUtilsMessengerEXTUnique(
+			getDebugUtilsMessengerCreateInfo()
+		);
+	}
+
+	void createSurface() {
+		if (options.offscreen)
+			return;
+
+		vk::SurfaceKHR tmpSurface;
+		if (!SDL_Vulkan_CreateSurface(window, static_cast<VkInstance>(instance.get()), reinterpret_cast<VkSurfaceKHR*>(&tmpSurface)))
+			throw std::runtime_error("failed to create SDL surface!");
+		surface = vk::UniqueSurfaceKHR(tmpSurface, instance.get());
+	}
+
+	void pickPhysicalDevice() {
+		std::vector<vk::PhysicalDevice> physicalDevices = instance->enumeratePhysicalDevices();
+
+		if (physicalDevices.size() == 0)
+			throw std::runtime_error("failed to find GPUs with Vulkan support!");
+
+		if (!options.gpu.empty()) {
+			physicalDevice = findRequestedDevice(physicalDevices);
+		} else {
+			uint64_t bestScore = 0;
+			for (const auto& device : physicalDevices) {
+				uint64_t score = isDeviceSuitable(device) ? scoreDevice(device) : 0;
+				if (profiling)
+					std::cout << "gpu " << device.getProperties().deviceName << ": score " << score << std::endl;
+				if (score > bestScore) {
+					physicalDevice = device;
+					bestScore = score;
+				}
+			}
+
+			if (bestScore == 0)
+				throw std::runtime_error("failed to find a suitable GPU!");
+		}
+
+		msaaSamples = chooseSampleCount();
+		if (options.deviceGroup)
+			findDeviceGroup();
+	}
+
+	//--gpu takes an index into the enumerated devices, or anything else as a case insensitive part of the device name
+	vk::PhysicalDevice findRequestedDevice(const std::vector<vk::PhysicalDevice>& physicalDevices) {
+		auto lowercase = [](std::string text) {
+			std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			return text;
+		};
+
+		bool isIndex = std::all_of(options.gpu.begin(), options.gpu.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+		for (size_t i = 0; i < physicalDevices.size(); ++i) {
+			std::string name = physicalDevices[i].getProperties().deviceName;
+			bool matches = isIndex ? std::stoul(options.gpu) == i : lowercase(name).find(lowercase(options.gpu)) != std::string::npos;
+			if (!matches)
+				continue;
+
+			if (!isDeviceSuitable(physicalDevices[i]))
+				throw std::runtime_error("the requested GPU " + name + " isn't suitable!");
+			return physicalDevices[i];
+		}
+
+		throw std::runtime_error("failed to find the requested GPU " + options.gpu + "!");
+	}
+
+	//the device type dominates, so a discrete gpu always beats an integrated one, and memory, sample counts and
+	//compressed texture support only decide between devices of the same type. 0 is left for unsuitable devices
+	uint64_t scoreDevice(vk::PhysicalDevice device) {
+		vk::PhysicalDeviceProperties properties = device.getProperties();
+		vk::PhysicalDeviceFeatures features = device.getFeatures();
+		vk::PhysicalDeviceMemoryProperties memoryProperties = device.getMemoryProperties();
+
+		uint64_t score = 1;
+		switch (properties.deviceType) {
+		case vk::PhysicalDeviceType::eDiscreteGpu: score += 4000000; break;
+		case vk::PhysicalDeviceType::eIntegratedGpu: score += 3000000; break;
+		case vk::PhysicalDeviceType::eVirtualGpu: score += 2000000; break;
+		case vk::PhysicalDeviceType::eCpu: score += 1000000; break;
+		default: break;
+		}
+
+		//one point per MiB of device local memory, capped well below the type's weight
+		vk::DeviceSize deviceLocalBytes = 0;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+			if (memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+				deviceLocalBytes += memoryProperties.memoryHeaps[i].size;
+		}
+		score += std::min<uint64_t>(deviceLocalBytes / (1024 * 1024), 900000);
+
+		vk::SampleCountFlags sampleCounts = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+		for (uint32_t samples = 2; samples <= 64; samples *= 2) {
+			if (sampleCounts & static_cast<vk::SampleCountFlagBits>(samples))
+				score += 1000;
+		}
+
+		if (features.textureCompressionBC)
+			score += 500;
+		if (features.textureCompressionASTC_LDR)
+			score += 500;
+		if (features.textureCompressionETC2)
+			score += 500;
+		if (device.getFormatProperties(vk::Format::eD32Sfloat).optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+			score += 100;
+
+		return score;
+	}
+
+	//the features2, memory properties2 and device group entry points are core 1.1, both the instance and the device need it
+	bool supportsVulkan11(vk::PhysicalDevice device) {
+		return instanceApiVersion >= VK_API_VERSION_1_1 && device.getProperties().apiVersion >= VK_API_VERSION_1_1;
+	}
+
+	//only the chosen device's own group is used, a group of one is just the device on its own
+	void findDeviceGroup() {
+		if (!supportsVulkan11(physicalDevice)) {
+			std::cerr << "device groups need Vulkan 1.1, rendering on the GPU alone" << std::endl;
+			return;
+		}
+
+		for (const auto& group : instance->enumeratePhysicalDeviceGroups()) {
+			std::vector<vk::PhysicalDevice> groupDevices(group.physicalDevices, group.physicalDevices + group.physicalDeviceCount);
+			if (std::find(groupDevices.begin(), groupDevices.end(), physicalDevice) == groupDevices.end())
+				continue;
+
+			if (groupDevices.size() > 1)
+				deviceGroupDevices = groupDevices;
+			break;
+		}
+
+		if (deviceGroupDevices.empty())
+			std::cerr << "the GPU isn't part of a device group, rendering on it alone" << std::endl;
+	}
+
+	vk::SampleCountFlagBits getMaxUsableSampleCount() {
+		vk::PhysicalDeviceProperties physicalDeviceProperties = physicalDevice.getProperties();
+
+		vk::SampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts &
+			physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+		if (counts & vk::SampleCountFlagBits::e64) return vk::SampleCountFlagBits::e64;
+		if (counts & vk::SampleCountFlagBits::e32) return vk::SampleCountFlagBits::e32;
+		if (counts & vk::SampleCountFlagBits::e16) return vk::SampleCountFlagBits::e16;
+		if (counts & vk::SampleCountFlagBits::e8) return vk::SampleCountFlagBits::e8;
+		if (counts & vk::SampleCountFlagBits::e4) return vk::SampleCountFlagBits::e4;
+		if (counts & vk::SampleCountFlagBits::e2) return vk::SampleCountFlagBits::e2;
+
+		return vk::SampleCountFlagBits::e1;
+	}
+
+	//the requested count if the device can do it for both color and depth, otherwise the closest one below it
+	vk::SampleCountFlagBits chooseSampleCount() {
+		if (options.msaaSamples == 0)
+			return getMaxUsableSampleCount();
+
+		vk::PhysicalDeviceLimits limits = physicalDevice.getProperties().limits;
+		vk::SampleCountFlags counts = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+		uint32_t samples = options.msaaSamples;
+		while (samples > 1 && !(counts & static_cast<vk::SampleCountFlagBits>(samples)))
+			samples /= 2;
+
+		if (samples != options.msaaSamples)
+			std::cerr << options.msaaSamples << "x msaa isn't supported, using " << samples << "x" << std::endl;
+		return static_cast<vk::SampleCountFlagBits>(samples);
+	}
+
+	//without msaa there's nothing to resolve and the swapchain image is the color attachment itself
+	bool resolvesColor() {
+		return msaaSamples != vk::SampleCountFlagBits::e1;
+	}
+
+	void createLogicalDevice() {
+		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+
+		std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
+		std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value()};
+
+		float queuePriority = 1.0f;
+		for (uint32_t queueFamily : uniqueQueueFamilies) {
+			queueCreateInfos.push_back(
+				vk::DeviceQueueCreateInfo({}, queueFamily, 1, &queuePriority)
+			);
+		}
+
+		vk::PhysicalDeviceFeatures deviceFeatures = {};
+		deviceFeatures.samplerAnisotropy = true;
+		deviceFeatures.sampleRateShading = true;
+
+		//the draws are recorded into secondaries, so statistics queries also need to be inheritable
+		vk::PhysicalDeviceFeatures supportedFeatures = physicalDevice.getFeatures();
+		statisticsQueries = profiling && supportedFeatures.pipelineStatisticsQuery && supportedFeatures.inheritedQueries;
+		deviceFeatures.pipelineStatisticsQuery = statisticsQueries;
+		deviceFeatures.inheritedQueries = statisticsQueries;
+
+		//whichever block compression the device has, loadTextureData() then picks a container it can sample
+		deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+		deviceFeatures.textureCompressionETC2 = supportedFeatures.textureCompressionETC2;
+		deviceFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
+
+		//the culling pass runs on the graphics queue, between the upload wait and the render pass
+		gpuCulling = options.gpuCulling &&
+			(physicalDevice.getQueueFamilyProperties()[indices.graphicsFamily.value()].queueFlags & vk::QueueFlagBits::eCompute);
+		if (options.gpuCulling && !gpuCulling)
+			std::cerr << "the graphics queue can't run compute shaders, drawing every instance without culling" << std::endl;
+		multiDrawIndirect = gpuCulling && supportedFeatures.multiDrawIndirect;
+		deviceFeatures.multiDrawIndirect = multiDrawIndirect;
+		drawIndirectFirstInstance = gpuCulling && supportedFeatures.drawIndirectFirstInstance;
+		deviceFeatures.drawIndirectFirstInstance = drawIndirectFirstInstance;
+
+		uint32_t enabledLayerCount = 0;
+		if (enableValidationLayers)
+			enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+
+		//nothing is presented offscreen, so the device doesn't need VK_KHR_swapchain either
+		std::vector<const char*> extensions = options.offscreen ? std::vector<const char*>() : deviceExtensions;
+		void* featureChain = nullptr;
+		//without a count buffer the culled draws come out with zero instances instead of being skipped
+		bool drawIndirectCount = gpuCulling && deviceExtensionSupported(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		if (drawIndirectCount)
+			extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		vk::DeviceCreateInfo createInfo(
+			{},
+			static_cast<uint32_t>(queueCreateInfos.size()), queueCreateInfos.data(),
+			enabledLayerCount, validationLayers.data(),
+			0, nullptr,
+			&deviceFeatures
+		);
+
+#ifdef VK_KHR_timeline_semaphore
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timelineFeatures.timelineSemaphore = VK_TRUE;
+
+		bool useTimeline = options.timelineSemaphores && timelineSemaphoresSupported(physicalDevice);
+		if (useTimeline) {
+			extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			timelineFeatures.pNext = featureChain;
+			featureChain = &timelineFeatures;
+		}
+#else
+		bool useTimeline = false;
+#endif
+		if (options.timelineSemaphores && !useTimeline)
+			std::cerr << "timeline semaphores aren't supported, falling back to fences" << std::endl;
+
+		//the texture index only changes between draws, so dynamic indexing without nonuniformEXT is enough
+		vk::PhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures;
+		bindless = options.bindless && bindlessSupported(physicalDevice);
+		if (bindless) {
+			extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			deviceFeatures.shaderSampledImageArrayDynamicIndexing = true;
+			indexingFeatures.runtimeDescriptorArray = true;
+			indexingFeatures.descriptorBindingPartiallyBound = true;
+			indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = bindlessUpdateAfterBind;
+			indexingFeatures.descriptorBindingUpdateUnusedWhilePending = bindlessUpdateUnusedWhilePending;
+			indexingFeatures.pNext = featureChain;
+			featureChain = &indexingFeatures;
+
+			//a streamed texture is written to a slot no frame in flight uses, which is only allowed with one of these
+			if (textureStreaming && !bindlessUpdateAfterBind && !bindlessUpdateUnusedWhilePending) {
+				std::cerr << "bindless descriptors can't be updated while frames are in flight, not streaming the texture" << std::endl;
+				textureStreaming = false;
+			}
+		}
+		else if (options.bindless)
+			std::cerr << "descriptor indexing isn't supported, binding the texture directly" << std::endl;
+
+		//present latency is only measured while profiling, present wait bounds it from above and display timing is the fallback
+		bool measurePresents = profiling && !options.offscreen;
+#ifdef VK_KHR_present_wait
+		VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+		presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		presentIdFeatures.presentId = VK_TRUE;
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+		presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		presentWaitFeatures.presentWait = VK_TRUE;
+
+		if (measurePresents && presentWaitSupported(physicalDevice)) {
+			extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+			presentWaitFeatures.pNext = featureChain;
+			presentIdFeatures.pNext = &presentWaitFeatures;
+			featureChain = &presentIdFeatures;
+			presentTiming = PresentTiming::ePresentWait;
+		}
+#endif
+		memoryBudget = textureStreaming && supportsVulkan11(physicalDevice) && deviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (memoryBudget)
+			extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+		if (measurePresents && presentTiming == PresentTiming::eNone && deviceExtensionSupported(physicalDevice, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME)) {
+			extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+			presentTiming = PresentTiming::eDisplayTiming;
+		}
+
+#ifdef VK_KHR_dynamic_rendering
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+		dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+		dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+		VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features = {};
+		synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+		synchronization2Features.synchronization2 = VK_TRUE;
+
+		dynamicRendering = options.dynamicRendering && dynamicRenderingSupported(physicalDevice);
+		if (dynamicRendering) {
+			//dynamic rendering depends on depth stencil resolve, which depends on create renderpass 2, on a 1.1 device
+			extensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+			extensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+			extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+			extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+			synchronization2Features.pNext = featureChain;
+			dynamicRenderingFeatures.pNext = &synchronization2Features;
+			featureChain = &dynamicRenderingFeatures;
+		}
+#endif
+		if (options.dynamicRendering && !dynamicRendering)
+			std::cerr << "dynamic rendering isn't supported, using a render pass" << std::endl;
+
+		vk::DeviceGroupDeviceCreateInfo deviceGroupInfo(
+			static_cast<uint32_t>(deviceGroupDevices.size()), deviceGroupDevices.data()
+		);
+		if (!deviceGroupDevices.empty()) {
+			extensions.push_back(VK_KHR_DEVICE_GROUP_EXTENSION_NAME);
+			deviceGroupInfo.pNext = featureChain;
+			featureChain = &deviceGroupInfo;
+		}
+
+		createInfo.pNext = featureChain;
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
+		device = physicalDevice.createDeviceUnique(createInfo);
+
+		if (drawIndirectCount)
+			drawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(device->getProcAddr("vkCmdDrawIndexedIndirectCountKHR"));
+
+#ifdef VK_KHR_dynamic_rendering
+		if (dynamicRendering) {
+			cmdBeginRenderingKHR = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(device->getProcAddr("vkCmdBeginRenderingKHR"));
+			cmdEndRenderingKHR = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(device->getProcAddr("vkCmdEndRenderingKHR"));
+			cmdPipelineBarrier2KHR = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(device->getProcAddr("vkCmdPipelineBarrier2KHR"));
+		}
+#endif
+
+#ifdef VK_KHR_timeline_semaphore
+		if (useTimeline)
+			waitSemaphoresKHR = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(device->getProcAddr("vkWaitSemaphoresKHR"));
+#endif
+		//each device presenting its own images is the only mode that lets alternate frames go out without copies
+		if (!deviceGroupDevices.empty() && !options.offscreen) {
+			if (device->getGroupPresentCapabilitiesKHR().modes & vk::DeviceGroupPresentModeFlagBitsKHR::eLocal)
+				alternateFrameDevices = static_cast<uint32_t>(deviceGroupDevices.size());
+			else
+				std::cerr << "the device group can't present locally, rendering every frame on the first device" << std::endl;
+		}
+
+#ifdef VK_KHR_present_wait
+		if (presentTiming == PresentTiming::ePresentWait)
+			waitForPresentKHR = reinterpret_cast<PFN_vkWaitForPresentKHR>(device->getProcAddr("vkWaitForPresentKHR"));
+#endif
+
+		graphicsQueue = device->getQueue(indices.graphicsFamily.value(), 0);
+		presentQueue = device->getQueue(indices.presentFamily.value(), 0);
+		transferQueue = device->getQueue(indices.transferFamily.value(), 0);
+		graphicsQueueFamily = indices.graphicsFamily.value();
+		transferQueueFamily = indices.transferFamily.value();
+
+		allocator.init(physicalDevice, device.get());
+	}
+
+	bool deviceExtensionSupported(vk::PhysicalDevice device, const char* name) {
+		for (const auto& extension : device.enumerateDeviceExtensionProperties()) {
+			if (std::string(extension.extensionName) == name)
+				return true;
+		}
+
+		return false;
+	}
+
+	//update after bind is only a nicety, textures could otherwise only be added while no frame is in flight
+	bool bindlessSupported(vk::PhysicalDevice device) {
+		if (!supportsVulkan11(device) || !deviceExtensionSupported(device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+			return false;
+
+		auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+		const auto& indexingFeatures = features.get<vk::PhysicalDeviceDescriptorIndexingFeaturesEXT>();
+		if (!features.get<vk::PhysicalDeviceFeatures2>().features.shaderSampledImageArrayDynamicIndexing ||
+				!indexingFeatures.runtimeDescriptorArray || !indexingFeatures.descriptorBindingPartiallyBound)
+			return false;
+
+		bindlessUpdateAfterBind = indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+		bindlessUpdateUnusedWhilePending = indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+
+		auto properties = device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDescriptorIndexingPropertiesEXT>();
+		const auto& limits = properties.get<vk::PhysicalDeviceProperties2>().properties.limits;
+		const auto& indexingProperties = properties.get<vk::PhysicalDeviceDescriptorIndexingPropertiesEXT>();
+		bindlessTextureCapacity = bindlessUpdateAfterBind ?
+			std::min(indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages) :
+			std::min(limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSampledImages);
+		bindlessTextureCapacity = std::min(bindlessTextureCapacity, BINDLESS_TEXTURE_CAPACITY);
+
+		return bindlessTextureCapacity > 0;
+	}
+
+#ifdef VK_KHR_timeline_semaphore
+	bool timelineSemaphoresSupported(vk::PhysicalDevice device) {
+		if (!supportsVulkan11(device))
+			return false;
+
+		if (!deviceExtensionSupported(device, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+			return false;
+
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &timelineFeatures;
+		vkGetPhysicalDeviceFeatures2(device, &features);
+
+		return timelineFeatures.timelineSemaphore == VK_TRUE;
+	}
+#endif
+
+#ifdef VK_KHR_dynamic_rendering
+	bool dynamicRenderingSupported(vk::PhysicalDevice device) {
+		if (!supportsVulkan11(device))
+			return false;
+
+		for (const char* extension : {
+				VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+				VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME}) {
+			if (!deviceExtensionSupported(device, extension))
+				return false;
+		}
+
+		VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features = {};
+		synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+		dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+		dynamicRenderingFeatures.pNext = &synchronization2Features;
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &dynamicRenderingFeatures;
+		vkGetPhysicalDeviceFeatures2(device, &features);
+
+		return dynamicRenderingFeatures.dynamicRendering == VK_TRUE && synchronization2Features.synchronization2 == VK_TRUE;
+	}
+#endif
+
+#ifdef VK_KHR_present_wait
+	bool presentWaitSupported(vk::PhysicalDevice device) {
+		if (!supportsVulkan11(device))
+			return false;
+
+		if (!deviceExtensionSupported(device, VK_KHR_PRESENT_ID_EXTENSION_NAME) || !deviceExtensionSupported(device, VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+			return false;
+
+		VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+		presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+		VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+		presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+		presentIdFeatures.pNext = &presentWaitFeatures;
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &presentIdFeatures;
+		vkGetPhysicalDeviceFeatures2(device, &features);
+
+		return presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
+	}
+#endif
+
+	void createSwapchain() {
+		if (options.offscreen) {
+			createOffscreenTarget();
+			return;
+		}
+
+		SwapchainSupportDetails swapchainSupport = querySwapchainSupport(physicalDevice);
+
+		vk::SurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapchainSupport.formats);
+		vk::PresentModeKHR presentMode = chooseSwapPresentMode(swapchainSupport.presentModes);
+		vk::Extent2D extent = chooseSwapExtent(swapchainSupport.capabilities);
+
+		uint32_t imageCount = swapchainSupport.capabilities.minImageCount + 1;
+		if (options.swapchainImages > 0)
+			imageCount = std::max(options.swapchainImages, swapchainSupport.capabilities.minImageCount);
+		if (swapchainSupport.capabilities.maxImageCount > 0 && imageCount > swapchainSupport.capabilities.maxImageCount)
+			imageCount = swapchainSupport.capabilities.maxImageCount;
+		if (options.swapchainImages > 0 && imageCount != options.swapchainImages)
+			std::cerr << "the surface can't have " << options.swapchainImages << " swapchain images, asking for " << imageCount << std::endl;
+
+		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+		uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+
+		vk::SharingMode sharingMode = vk::SharingMode::eExclusive;
+		if (indices.graphicsFamily != indices.presentFamily)
+			sharingMode = vk::SharingMode::eConcurrent;
+		
+		//handing over the old swapchain lets the driver recycle its resources and keep presenting without a blank frame
+		vk::SwapchainCreateInfoKHR swapchainInfo(
+			vk::SwapchainCreateFlagsKHR(), surface.get(),
+			imageCount, surfaceFormat.format,
+			surfaceFormat.colorSpace, extent,
+			1, vk::ImageUsageFlagBits::eColorAttachment,
+			sharingMode, 2, queueFamilyIndices,
+			swapchainSupport.capabilities.currentTransform, vk::CompositeAlphaFlagBitsKHR::eOpaque,
+			presentMode, true,
+			swapchain.get()
+		);
+
+		vk::DeviceGroupSwapchainCreateInfoKHR deviceGroupSwapchainInfo(vk::DeviceGroupPresentModeFlagBitsKHR::eLocal);
+		if (alternateFrameDevices > 1)
+			swapchainInfo.pNext = &deviceGroupSwapchainInfo;
+
+		vk::UniqueSwapchainKHR newSwapchain = device->createSwapchainKHRUnique(swapchainInfo);
+
+		if (swapchain) {
+			retiredSwapchain = std::move(swapchain);
+			framesSinceSwapchainRetired = 0;
+		}
+		swapchain = std::move(newSwapchain);
+		//the ids were handed to the old swapchain, which won't report on them any more
+		pendingPresents.clear();
+
+		swapchainImages = device->getSwapchainImagesKHR(swapchain.get());
+		swapchainImageFormat = surfaceFormat.format;
+		swapchainExtent = extent;
+	}
+
+	//images in the format the readback buffers are written out in, every device can render to and copy from it.
+	//frames render into the image of their frame slot, which is only reused once the slot's previous frame, copy included, is done
+	void createOffscreenTarget() {
+		swapchainImageFormat = vk::Format::eR8G8B8A8Unorm;
+		swapchainExtent = vk::Extent2D(static_cast<uint32_t>(WIDTH), static_cast<uint32_t>(HEIGHT));
+
+		offscreenImages.resize(framesInFlight);
+		offscreenImageMemory.resize(framesInFlight);
+		swapchainImages.clear();
+		for (size_t i = 0; i < framesInFlight; ++i) {
+			createImage(
+				swapchainExtent.width, swapchainExtent.height, 1, vk::SampleCountFlagBits::e1, swapchainImageFormat, vk::ImageTiling::eOptimal,
+				vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eDeviceLocal,
+				offscreenImages[i], offscreenImageMemory[i]
+			);
+			swapchainImages.push_back(offscreenImages[i].get());
+		}
+	}
+
+	void createImageViews() {
+		swapchainImageViews.resize(swapchainImages.size());
+
+		for (size_t i = 0; i < swapchainImages.size(); ++i) {
+			swapchainImageViews[i] = createImageView(swapchainImages[i], swapchainImageFormat, vk::ImageAspectFlagBits::eColor, 1);
+		}
+	}
+
+	void createRenderPass() {
+		//the attachments are described when rendering begins instead
+		if (dynamicRendering)
+			return;
+
+		vk::ImageLayout presentLayout = options.offscreen ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
+
+		//the multisampled color only lives until it is resolved, so it never has to be written out to memory
+		vk::AttachmentDescription colorAttachment = {};
+		colorAttachment.format = swapchainImageFormat;
+		colorAttachment.samples = msaaSamples;
+		colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
+		colorAttachment.storeOp = resolvesColor() ? vk::AttachmentStoreOp::eDontCare : vk::AttachmentStoreOp::eStore;
+		colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+		colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+		colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
+		colorAttachment.finalLayout = resolvesColor() ? vk::ImageLayout::eColorAttachmentOptimal : presentLayout;
+
+		vk::AttachmentDescription depthAttachment = {};
+		depthAttachment.format = findDepthFormat();
+		depthAttachment.samples = msaaSamples;
+		depthAttachment.loadOp = vk::AttachmentLoadOp::eClear;
+		depthAttachment.storeOp = vk::AttachmentStoreOp::eDontCare;
+		depthAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+		depthAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+		depthAttachment.initialLayout = vk::ImageLayout::eUndefined;
+		depthAttachment.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+
+		vk::AttachmentDescription colorAttachmentResolve = {};
+		colorAttachmentResolve.format = swapchainImageFormat;
+		colorAttachmentResolve.samples = vk::SampleCountFlagBits::e1;
+		colorAttachmentResolve.loadOp = vk::AttachmentLoadOp::eDontCare;
+		colorAttachmentResolve.storeOp = vk::AttachmentStoreOp::eStore;
+		colorAttachmentResolve.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+		colorAttachmentResolve.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+		colorAttachmentResolve.initialLayout = vk::ImageLayout::eUndefined;
+		colorAttachmentResolve.finalLayout = presentLayout;
+
+		vk::AttachmentReference colorAttachmentRef(0, vk::ImageLayout::eColorAttachmentOptimal);
+
+		vk::AttachmentReference depthAttachmentRef(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+		vk::AttachmentReference colorAttachmentResolveRef(2, vk::ImageLayout::eColorAttachmentOptimal);
+
+		vk::SubpassDescription subpass;
+		subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+		subpass.pResolveAttachments = resolvesColor() ? &colorAttachmentResolveRef : nullptr;
+
+		vk::SubpassDependency dependency(
+			(uint32_t) VK_SUBPASS_EXTERNAL, (uint32_t) 0,
+			vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+			vk::AccessFlags(), vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+			vk::DependencyFlags()
+		);
+
+		std::vector<vk::AttachmentDescription> attachments = {colorAttachment, depthAttachment};
+		if (resolvesColor())
+			attachments.push_back(colorAttachmentResolve);
+
+		renderPass = device->createRenderPassUnique(
+			vk::RenderPassCreateInfo(
+				vk::RenderPassCreateFlags(), static_cast<uint32_t>(attachments.size()), attachments.data(), 1, &subpass, 1, &dependency
+			)
+		);
+	}
+
+	void createDescriptorSetLayout() {
+		vk::DescriptorSetLayoutBinding uboLayoutBinding = {};
+		uboLayoutBinding.binding = 0;
+		uboLayoutBinding.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+		uboLayoutBinding.descriptorCount = 1;
+		uboLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eVertex;
+		uboLayoutBinding.pImmutableSamplers = nullptr;
+
+		vk::DescriptorSetLayoutBinding samplerLayoutBinding = {};
+		samplerLayoutBinding.binding = 1;
+		samplerLayoutBinding.descriptorCount = 1;
+		samplerLayoutBinding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+		samplerLayoutBinding.pImmutableSamplers = nullptr;
+		samplerLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+		//in bindless mode the texture comes from set 1 instead
+		std::vector<vk::DescriptorSetLayoutBinding> bindings = { uboLayoutBinding };
+		if (!bindless)
+			bindings.push_back(samplerLayoutBinding);
+
+		vk::DescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		descriptorSetLayout = device->createDescriptorSetLayoutUnique(layoutInfo);
+
+		if (bindless)
+			createBindlessDescriptorSetLayout();
+	}
+
+	void createBindlessDescriptorSetLayout() {
+		std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {
+			vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eSampler, 1, vk::ShaderStageFlagBits::eFragment, nullptr),
+			vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eSampledImage, bindlessTextureCapacity, vk::ShaderStageFlagBits::eFragment, nullptr)
+		};
+
+		//slots past bindlessTextureCount are never written, partially bound makes that legal as long as nothing samples them.
+		//update unused while pending lets a streamed texture go into a slot the frames in flight don't sample
+		vk::DescriptorBindingFlagsEXT updateAfterBind = bindlessUpdateAfterBind ? vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind : vk::DescriptorBindingFlagsEXT();
+		vk::DescriptorBindingFlagsEXT imageFlags = updateAfterBind | vk::DescriptorBindingFlagBitsEXT::ePartiallyBound;
+		if (bindlessUpdateUnusedWhilePending)
+			imageFlags |= vk::DescriptorBindingFlagBitsEXT::eUpdateUnusedWhilePending;
+		std::array<vk::DescriptorBindingFlagsEXT, 2> bindingFlags = {updateAfterBind, imageFlags};
+		vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo(static_cast<uint32_t>(bindingFlags.size()), bindingFlags.data());
+
+		vk::DescriptorSetLayoutCreateInfo layoutInfo(
+			bindlessUpdateAfterBind ? vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPoolEXT : vk::DescriptorSetLayoutCreateFlags(),
+			static_cast<uint32_t>(bindings.size()), bindings.data()
+		);
+		layoutInfo.pNext = &bindingFlagsInfo;
+
+		bindlessDescriptorSetLayout = device->createDescriptorSetLayoutUnique(layoutInfo);
+	}
+
+	void createGraphicsPipeline() {
+		std::vector<vk::DescriptorSetLayout> setLayouts = {descriptorSetLayout.get()};
+		std::vector<vk::PushConstantRange> pushConstantRanges;
+		if (bindless) {
+			setLayouts.push_back(bindlessDescriptorSetLayout.get());
+			pushConstantRanges.emplace_back(vk::ShaderStageFlagBits::eFragment, 0, static_cast<uint32_t>(sizeof(uint32_t)));
+		}
+
+		pipelineLayout = device->createPipelineLayoutUnique(
+			vk::PipelineLayoutCreateInfo(
+				vk::PipelineLayoutCreateFlags(),
+				static_cast<uint32_t>(setLayouts.size()), setLayouts.data(),
+				static_cast<uint32_t>(pushConstantRanges.size()), pushConstantRanges.data()
+			)
+		);
+
+		const ShaderSource& fragmentShader = getFragmentShader();
+		if (hotReload) {
+			watchShader(VERTEX_SHADER, false);
+			watchShader(fragmentShader, false);
+		}
+
+		graphicsShaderCode.vertex = loadShaderCode(VERTEX_SHADER);
+		graphicsShaderCode.fragment = loadShaderCode(fragmentShader);
+		graphicsPipelines = buildPipelineVariants(graphicsShaderCode);
+	}
+
+	PipelineVariant getPipelineVariant(bool textured, bool alphaTest) {
+		PipelineVariant variant = {};
+		variant.vertexFormat = vertexFormat;
+		variant.sampleCount = static_cast<uint32_t>(msaaSamples);
+		variant.bindless = bindless;
+		variant.textured = textured;
+		variant.alphaTest = alphaTest;
+		return variant;
+	}
+
+	static uint64_t hashPipelineVariant(const PipelineVariant& variant) {
+		return hashBytes(reinterpret_cast<const uint8_t*>(&variant), sizeof(variant));
+	}
+
+	//compiles every material variant on the workers at once, so no material stalls the frame it is first drawn in
+	std::unordered_map<uint64_t, vk::UniquePipeline> buildPipelineVariants(const GraphicsShaderCode& shaderCode) {
+		std::vector<PipelineVariant> variants;
+		for (const auto& material : MATERIAL_VARIANTS)
+			variants.push_back(getPipelineVariant(material[0] != 0, material[1] != 0));
+
+		std::vector<vk::UniquePipeline> pipelines(variants.size());
+		workers->parallelFor(static_cast<uint32_t>(variants.size()), [&](uint32_t i, uint32_t) {
+			pipelines[i] = buildGraphicsPipeline(variants[i], shaderCode);
+		});
+
+		std::unordered_map<uint64_t, vk::UniquePipeline> variantPipelines;
+		for (size_t i = 0; i < variants.size(); ++i)
+			variantPipelines[hashPipelineVariant(variants[i])] = std::move(pipelines[i]);
+		return variantPipelines;
+	}
+
+	//called from the recording workers, a variant that wasn't warmed is built on the spot by whichever worker needs it first
+	vk::Pipeline getGraphicsPipeline(const PipelineVariant& variant) {
+		uint64_t key = hashPipelineVariant(variant);
+		{
+			std::lock_guard<std::mutex> lock(graphicsPipelinesMutex);
+			auto found = graphicsPipelines.find(key);
+			if (found != graphicsPipelines.end())
+				return found->second.get();
+		}
+
+		vk::UniquePipeline pipeline = buildGraphicsPipeline(variant, graphicsShaderCode);
+
+		std::lock_guard<std::mutex> lock(graphicsPipelinesMutex);
+		vk::UniquePipeline& entry = graphicsPipelines[key];
+		if (!entry)
+			entry = std::move(pipeline);
+		return entry.get();
+	}
+
+	const ShaderSource& getFragmentShader() {
+		return bindless ? BINDLESS_FRAGMENT_SHADER : FRAGMENT_SHADER;
+	}
+
+	//only reads state that is fixed until the next swapchain recreation, so shader reloads can call it from a worker
+	vk::UniquePipeline buildGraphicsPipeline(const PipelineVariant& variant, const GraphicsShaderCode& shaderCode) {
+		vk::UniqueShaderModule vertShaderModule = createShaderModule(shaderCode.vertex);
+		vk::UniqueShaderModule fragShaderModule = createShaderModule(shaderCode.fragment);
+
+		std::array<vk::SpecializationMapEntry, 2> specializationEntries = {
+			vk::SpecializationMapEntry(0, offsetof(PipelineVariant, textured), sizeof(uint32_t)),
+			vk::SpecializationMapEntry(1, offsetof(PipelineVariant, alphaTest), sizeof(uint32_t))
+		};
+		vk::SpecializationInfo specializationInfo(
+			static_cast<uint32_t>(specializationEntries.size()), specializationEntries.data(), sizeof(variant), &variant
+		);
+
+		vk::PipelineShaderStageCreateInfo vertShaderStageInfo(
+			vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eVertex, vertShaderModule.get(), "main"
+		);
+		vk::PipelineShaderStageCreateInfo fragShaderStageInfo(
+			vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eFragment, fragShaderModule.get(), "main", &specializationInfo
+		);
+
+		vk::PipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+		std::array<vk::VertexInputBindingDescription, 2> bindingDescriptions = {
+			Vertex::getBindingDescription(variant.vertexFormat), Vertex::getInstanceBindingDescription()
+		};
+
+		std::vector<vk::VertexInputAttributeDescription> attributeDescriptions;
+		for (const auto& attribute : Vertex::getAttributeDescriptions(variant.vertexFormat))
+			attributeDescriptions.push_back(attribute);
+		for (const auto& attribute : Vertex::getInstanceAttributeDescriptions())
+			attributeDescriptions.push_back(attribute);
+
+		vk::PipelineVertexInputStateCreateInfo vertexInputInfo(
+			vk::PipelineVertexInputStateCreateFlags(), 
+			static_cast<uint32_t>(bindingDescriptions.size()), bindingDescriptions.data(),
+			static_cast<uint32_t>(attributeDescriptions.size()), attributeDescriptions.data()
+		);
+
+		vk::PipelineInputAssemblyStateCreateInfo inputAssembly(
+			vk::PipelineInputAssemblyStateCreateFlags(), vk::PrimitiveTopology::eTriangleList, false
+		);
+
+		//viewport and scissor are set while recording so the pipeline survives resizes
+		vk::PipelineViewportStateCreateInfo viewportState(
+			vk::PipelineViewportStateCreateFlags(), 1, nullptr, 1, nullptr
+		);
+
+		std::array<vk::DynamicState, 2> dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+		vk::PipelineDynamicStateCreateInfo dynamicState(
+			vk::PipelineDynamicStateCreateFlags(), static_cast<uint32_t>(dynamicStates.size()), dynamicStates.data()
+		);
+
+		vk::PipelineRasterizationStateCreateInfo rasterizer(
+			vk::PipelineRasterizationStateCreateFlags(), false, false,
+			vk::PolygonMode::eFill, vk::CullModeFlagBits::eBack, vk::FrontFace::eCounterClockwise, 
+			false, 0.0f, 0.0f, 0.0f, 1.0f
+		);
+
+		vk::PipelineMultisampleStateCreateInfo multisampling(
+			vk::PipelineMultisampleStateCreateFlags(), static_cast<vk::SampleCountFlagBits>(variant.sampleCount), 
+			true, 0.2f, nullptr, false, false
+		);
+
+		vk::PipelineDepthStencilStateCreateInfo depthStencil = {};
+		depthStencil.depthTestEnable = true;
+		depthStencil.depthWriteEnable = true;
+		depthStencil.depthCompareOp = vk::CompareOp::eLess;
+		depthStencil.depthBoundsTestEnable = false;
+		depthStencil.stencilTestEnable = false;
+
+		vk::PipelineColorBlendAttachmentState colorBlendAttachment;
+		colorBlendAttachment.blendEnable = false;
+		colorBlendAttachment.colorWriteMask =
+			vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+			vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+
+		vk::PipelineColorBlendStateCreateInfo colorBlending(
+			vk::PipelineColorBlendStateCreateFlags(), false, vk::LogicOp::eClear, 1, &colorBlendAttachment
+		);
+
+		vk::GraphicsPipelineCreateInfo pipelineInfo;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pDepthStencilState = &depthStencil;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
+		pipelineInfo.layout = pipelineLayout.get();
+		pipelineInfo.renderPass = renderPass.get();
+		pipelineInfo.subpass = 0;
+
+#ifdef VK_KHR_dynamic_rendering
+		VkFormat colorFormat = static_cast<VkFormat>(swapchainImageFormat);
+		VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachmentFormats = &colorFormat;
+		renderingInfo.depthAttachmentFormat = static_cast<VkFormat>(findDepthFormat());
+		if (dynamicRendering)
+			pipelineInfo.pNext = &renderingInfo;
+#endif
+
+		return device->createGraphicsPipelineUnique(pipelineCache.get(), pipelineInfo);
+	}
+
+	void createPipelineCache() {
+		std::vector<uint8_t> initialData = loadPipelineCacheData();
+
+		pipelineCache = device->createPipelineCacheUnique(
+			vk::PipelineCacheCreateInfo(
+				vk::PipelineCacheCreateFlags(), initialData.size(), initialData.data()
+			)
+		);
+	}
+
+	std::vector<uint8_t> loadPipelineCacheData() {
+		MappedFile file;
+		if (!file.open(PIPELINE_CACHE_PATH) || file.size() < sizeof(PipelineCacheFileHeader))
+			return {};
+
+		PipelineCacheFileHeader header;
+		memcpy(&header, file.data(), sizeof(header));
+		const uint8_t* data = file.data() + sizeof(header);
+
+		vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+		bool valid = header.magic == PIPELINE_CACHE_MAGIC &&
+			header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+			header.driverVersion == properties.driverVersion &&
+			memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+			header.dataSize == file.size() - sizeof(header) &&
+			header.dataHash == hashBytes(data, static_cast<size_t>(header.dataSize));
+
+		//not every driver survives being handed a blob from a different driver build, so reject it here
+		if (!valid) {
+			std::cerr << "discarding stale pipeline cache" << std::endl;
+			return {};
+		}
+
+		return std::vector<uint8_t>(data, data + header.dataSize);
+	}
+
+	void savePipelineCache() {
+		if (!pipelineCache)
+			return;
+
+		std::vector<uint8_t> data = device->getPipelineCacheData(pipelineCache.get());
+		vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+
+		PipelineCacheFileHeader header = {};
+		header.magic = PIPELINE_CACHE_MAGIC;
+		header.vendorID = properties.vendorID;
+		header.deviceID = properties.deviceID;
+		header.driverVersion = properties.driverVersion;
+		memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+		header.dataSize = data.size();
+		header.dataHash = hashBytes(data.data(), data.size());
+
+		std::string tempPath = PIPELINE_CACHE_PATH + ".tmp";
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "failed to write pipeline cache!" << std::endl;
+			return;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		file.close();
+
+		std::error_code ec;
+		if (file.fail())
+			std::filesystem::remove(tempPath, ec);
+		else
+			std::filesystem::rename(tempPath, PIPELINE_CACHE_PATH, ec);
+
+		if (file.fail() || ec)
+			std::cerr << "failed to write pipeline cache!" << std::endl;
+	}
+
+	void createFramebuffers() {
+		if (dynamicRendering)
+			return;
+
+		swapchainFramebuffers.resize(swapchainImageViews.size());
+
+		for (size_t i = 0; i < swapchainImageViews.size(); ++i) {
+			std::vector<vk::ImageView> attachments = {colorImageView.get(), depthImageView.get(), swapchainImageViews[i].get()};
+			if (!resolvesColor())
+				attachments = {swapchainImageViews[i].get(), depthImageView.get()};
+
+			swapchainFramebuffers[i] = device->createFramebufferUnique(
+				vk::FramebufferCreateInfo(
+					vk::FramebufferCreateFlags(), renderPass.get(),
+					static_cast<uint32_t>(attachments.size()), attachments.data(),
+					swapchainExtent.width, swapchainExtent.height,
+					1
+				)
+			);
+		}
+	}
+
+	void createColorResources() {
+		if (!resolvesColor())
+			return;
+
+		vk::Format colorFormat = swapchainImageFormat;
+
+		createImage(
+			swapchainExtent.width, swapchainExtent.height, 1, msaaSamples, colorFormat, vk::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal,
+			colorImage, colorImageMemory, getAttachmentMemoryPreference()
+		);
+
+		colorImageView = createImageView(colorImage.get(), colorFormat, vk::ImageAspectFlagBits::eColor, 1);
+	}
+
+	void createCommandPools() {
+		frameCommandPools.resize(framesInFlight);
+		workerCommandPools.resize(framesInFlight);
+
+		//everything is re-recorded every frame, so pools are reset wholesale once their frame has finished
+		for (size_t i = 0; i < framesInFlight; ++i) {
+			frameCommandPools[i] = device->createCommandPoolUnique(
+				vk::CommandPoolCreateInfo(
+					vk::CommandPoolCreateFlagBits::eTransient, graphicsQueueFamily
+				)
+			);
+
+			workerCommandPools[i].resize(workers->size());
+			for (auto& workerPool : workerCommandPools[i]) {
+				workerPool.pool = device->createCommandPoolUnique(
+					vk::CommandPoolCreateInfo(
+						vk::CommandPoolCreateFlagBits::eTransient, graphicsQueueFamily
+					)
+				);
+			}
+		}
+	}
+
+	void createQueryPools() {
+		if (!profiling)
+			return;
+
+		vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+		uint32_t validBits = physicalDevice.getQueueFamilyProperties()[graphicsQueueFamily].timestampValidBits;
+
+		timestampQueries = validBits > 0;
+		timestampPeriod = properties.limits.timestampPeriod;
+		timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+		if (!timestampQueries)
+			std::cerr << "graphics queue doesn't support timestamps, only cpu times will be reported" << std::endl;
+
+		for (size_t i = 0; i < framesInFlight; ++i) {
+			if (timestampQueries) {
+				timestampQueryPools.push_back(device->createQueryPoolUnique(
+					vk::QueryPoolCreateInfo(
+						vk::QueryPoolCreateFlags(), vk::QueryType::eTimestamp, GPU_SCOPE_COUNT * 2, vk::QueryPipelineStatisticFlags()
+					)
+				));
+			}
+
+			if (statisticsQueries) {
+				statisticsQueryPools.push_back(device->createQueryPoolUnique(
+					vk::QueryPoolCreateInfo(
+						vk::QueryPoolCreateFlags(), vk::QueryType::ePipelineStatistics, 1, getPipelineStatisticFlags()
+					)
+				));
+			}
+		}
+
+		frameProfiles.resize(framesInFlight);
+		frameQueriesWritten.assign(framesInFlight, false);
+		lastFrameStart = lastProfileSummary = std::chrono::high_resolution_clock::now();
+
+		if (!options.profileCsvPath.empty()) {
+			profileCsv.open(options.profileCsvPath);
+			if (!profileCsv)
+				throw std::runtime_error("failed to open " + options.profileCsvPath);
+
+			profileCsv << "frame,cpu_frame_ms,fence_wait_ms,acquire_ms,present_ms";
+			for (const char* name : GPU_SCOPE_NAMES)
+				profileCsv << ",gpu_" << name << "_ms";
+			profileCsv << ",vertex_invocations,fragment_invocations" << std::endl;
+		}
+	}
+
+	vk::QueryPipelineStatisticFlags getPipelineStatisticFlags() {
+		//results come back ordered by bit, so vertex before fragment
+		return vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations | vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+	}
+
+	void beginGpuScope(vk::CommandBuffer commandBuffer, size_t frame, GpuScope scope) {
+		if (debugLabels) {
+			VkDebugUtilsLabelEXT label = {};
+			label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+			label.pLabelName = GPU_SCOPE_NAMES[static_cast<uint32_t>(scope)];
+			cmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
+		}
+
+		if (timestampQueries)
+			commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestampQueryPools[frame].get(), static_cast<uint32_t>(scope) * 2);
+	}
+
+	void endGpuScope(vk::CommandBuffer commandBuffer, size_t frame, GpuScope scope) {
+		if (timestampQueries)
+			commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestampQueryPools[frame].get(), static_cast<uint32_t>(scope) * 2 + 1);
+
+		if (debugLabels)
+			cmdEndDebugUtilsLabelEXT(commandBuffer);
+	}
+
+	//marks where each frame's work starts on the queue, named like the frame argument of the cpu trace's events
+	void insertFrameLabel(vk::Queue queue, uint64_t number) {
+		if (!debugLabels)
+			return;
+
+		std::string name = "frame " + std::to_string(number);
+		VkDebugUtilsLabelEXT label = {};
+		label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+		label.pLabelName = name.c_str();
+		queueInsertDebugUtilsLabelEXT(queue, &label);
+	}
+
+	//only called once the frame has finished on the gpu, so the results are there and this never stalls
+	void collectFrameProfile(size_t frame) {
+		if (!profiling || !frameQueriesWritten[frame])
+			return;
+
+		frameQueriesWritten[frame] = false;
+		FrameProfile& profile = frameProfiles[frame];
+
+		if (timestampQueries) {
+			std::array<uint64_t, GPU_SCOPE_COUNT * 2> timestamps;
+			vk::Result result = device->getQueryPoolResults(
+				timestampQueryPools[frame].get(), 0, GPU_SCOPE_COUNT * 2,
+				sizeof(timestamps), timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64
+			);
+
+			profile.gpuTimesValid = result == vk::Result::eSuccess;
+			for (uint32_t i = 0; profile.gpuTimesValid && i < GPU_SCOPE_COUNT; ++i)
+				profile.gpuScopeMs[i] = ((timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask) * timestampPeriod / 1e6;
+		}
+
+		if (statisticsQueries) {
+			std::array<uint64_t, 2> statistics;
+			vk::Result result = device->getQueryPoolResults(
+				statisticsQueryPools[frame].get(), 0, 1,
+				sizeof(statistics), statistics.data(), sizeof(statistics), vk::QueryResultFlagBits::e64
+			);
+
+			profile.statisticsValid = result == vk::Result::eSuccess;
+			profile.vertexInvocations = statistics[0];
+			profile.fragmentInvocations = statistics[1];
+		}
+
+		reportFrameProfile(profile);
+	}
+
+	void reportFrameProfile(const FrameProfile& profile) {
+		if (options.benchmarkFrames > 0)
+			benchmarkProfiles.push_back(profile);
+
+		if (profileCsv.is_open()) {
+			profileCsv << profile.frameNumber << ',' << profile.cpuFrameMs << ',' << profile.fenceWaitMs << ','
+				<< profile.acquireMs << ',' << profile.presentMs;
+			for (double gpuMs : profile.gpuScopeMs)
+				profileCsv << ',' << (profile.gpuTimesValid ? gpuMs : 0.0);
+			profileCsv << ',' << profile.vertexInvocations << ',' << profile.fragmentInvocations << '\n';
+		}
+
+		if (!options.profile)
+			return;
+
+		profileSummary.push_back(profile);
+		if (millisecondsSince(lastProfileSummary) < 1000.0)
+			return;
+
+		FrameProfile average;
+		size_t gpuFrames = 0;
+		for (const auto& frame : profileSummary) {
+			average.cpuFrameMs += frame.cpuFrameMs;
+			average.fenceWaitMs += frame.fenceWaitMs;
+			average.acquireMs += frame.acquireMs;
+			average.presentMs += frame.presentMs;
+			average.vertexInvocations += frame.vertexInvocations;
+			average.fragmentInvocations += frame.fragmentInvocations;
+
+			if (frame.gpuTimesValid) {
+				++gpuFrames;
+				for (uint32_t i = 0; i < GPU_SCOPE_COUNT; ++i)
+					average.gpuScopeMs[i] += frame.gpuScopeMs[i];
+			}
+		}
+
+		double frameCount = static_cast<double>(profileSummary.size());
+		std::ostringstream summary;
+		summary.setf(std::ios::fixed);
+		summary.precision(2);
+		summary << "cpu " << average.cpuFrameMs / frameCount << " ms";
+		for (uint32_t i = 0; i < GPU_SCOPE_COUNT && gpuFrames > 0; ++i)
+			summary << ", gpu " << GPU_SCOPE_NAMES[i] << " " << average.gpuScopeMs[i] / gpuFrames << " ms";
+		summary << ", fence " << average.fenceWaitMs / frameCount << " ms"
+			<< ", acquire " << average.acquireMs / frameCount << " ms"
+			<< ", present " << average.presentMs / frameCount << " ms";
+		if (!recentPresentLatencies.empty()) {
+			double latencyTotal = 0.0;
+			for (double latency : recentPresentLatencies)
+				latencyTotal += latency;
+			summary << ", " << getPresentLatencyLabel() << " " << latencyTotal / recentPresentLatencies.size() << " ms";
+			recentPresentLatencies.clear();
+		}
+		if (statisticsQueries) {
+			summary << ", " << static_cast<uint64_t>(average.vertexInvocations / frameCount) << " vs / "
+				<< static_cast<uint64_t>(average.fragmentInvocations / frameCount) << " fs invocations";
+		}
+
+		std::cout << summary.str() << std::endl;
+		if (window)
+			SDL_SetWindowTitle(window, summary.str().c_str());
+
+		profileSummary.clear();
+		lastProfileSummary = std::chrono::high_resolution_clock::now();
+	}
+
+	//display timing reports when the image was actually shown. present wait only says that it has been by the time it is
+	//polled, which is once a frame, so those latencies are upper bounds rounded up to the frame interval
+	const char* getPresentLatencyLabel() {
+		return presentTiming == PresentTiming::ePresentWait ? "present latency (upper bound, polled once a frame)" : "present latency";
+	}
+
+	//how long presented frames took to reach the display, counted from the present call
+	void collectPresentTimings() {
+#ifdef VK_KHR_present_wait
+		//presents complete in order, so polling the oldest one with a zero timeout is enough. the swapchain is externally
+		//synchronised for vkWaitForPresentKHR, so a thread can't block in it while this one keeps presenting to timestamp it exactly
+		if (presentTiming == PresentTiming::ePresentWait) {
+			while (!pendingPresents.empty() && waitForPresentKHR(device.get(), swapchain.get(), pendingPresents.front().first, 0) == VK_SUCCESS) {
+				recordPresentLatency(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pendingPresents.front().second).count());
+				pendingPresents.pop_front();
+			}
+		}
+#endif
+
+		//the display timing clock is CLOCK_MONOTONIC on the platforms that have the extension, which is what steady_clock reads
+		if (presentTiming == PresentTiming::eDisplayTiming) {
+			for (const auto& timing : device->getPastPresentationTimingGOOGLE(swapchain.get())) {
+				while (!pendingPresents.empty() && pendingPresents.front().first < timing.presentID)
+					pendingPresents.pop_front();
+				if (pendingPresents.empty() || pendingPresents.front().first != timing.presentID)
+					continue;
+
+				double presentedNs = std::chrono::duration<double, std::nano>(pendingPresents.front().second.time_since_epoch()).count();
+				recordPresentLatency((static_cast<double>(timing.actualPresentTime) - presentedNs) / 1e6);
+				pendingPresents.pop_front();
+			}
+		}
+
+		while (pendingPresents.size() > PENDING_PRESENT_LIMIT)
+			pendingPresents.pop_front();
+	}
+
+	void recordPresentLatency(double latencyMs) {
+		if (options.benchmarkFrames > 0 && frameNumber >= BENCHMARK_WARMUP_FRAMES)
+			benchmarkPresentLatencies.push_back(latencyMs);
+		if (options.profile)
+			recentPresentLatencies.push_back(latencyMs);
+	}
+
+	void createUploadCommandPools() {
+		transferCommandPool = device->createCommandPoolUnique(
+			vk::CommandPoolCreateInfo(
+				vk::CommandPoolCreateFlagBits::eTransient, transferQueueFamily
+			)
+		);
+
+		//kept apart from the per-frame pools, which are reset long before a runtime upload completes
+		uploadCommandPool = device->createCommandPoolUnique(
+			vk::CommandPoolCreateInfo(
+				vk::CommandPoolCreateFlagBits::eTransient, graphicsQueueFamily
+			)
+		);
+	}
+
+	void createDepthResources() {
+		depthFormat = findDepthFormat();
+
+		createImage(
+			swapchainExtent.width, swapchainExtent.height, 1, msaaSamples, depthFormat, vk::ImageTiling::eOptimal,
+			vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal,
+			depthImage, depthImageMemory, getAttachmentMemoryPreference()
+		);
+
+		depthImageView = createImageView(depthImage.get(), depthFormat, vk::ImageAspectFlagBits::eDepth, 1);
+	}
+
+	//attachments that are cleared on load and never stored only need memory while a tile is being rendered,
+	//lazily allocated memory only exists on tilers and everything else just gets device local memory
+	vk::MemoryPropertyFlags getAttachmentMemoryPreference() {
+		return options.lazyAttachments ? vk::MemoryPropertyFlagBits::eLazilyAllocated : vk::MemoryPropertyFlags();
+	}
+
+	vk::Format findSupportedFormat(const std::vector<vk::Format>& candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features) {
+		for (vk::Format format : candidates) {
+			vk::FormatProperties props = physicalDevice.getFormatProperties(format);
+
+			if (tiling == vk::ImageTiling::eLinear && (props.linearTilingFeatures & features) == features) {
+				return format;
+			} else if (tiling == vk::ImageTiling::eOptimal && (props.optimalTilingFeatures & features) == features) {
+				return format;
+			}
+		}
+
+		throw std::runtime_error("failed to find supported format!");
+	}
+
+	vk::Format findDepthFormat() {
+		return findSupportedFormat(
+			{vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint},
+			vk::ImageTiling::eOptimal,
+			vk::FormatFeatureFlagBits::eDepthStencilAttachment
+		);
+	}
+
+	bool hasStencilComponent(vk::Format format) {
+		return format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
+	}
+
+	bool canSampleTextureFormat(vk::Format format) {
+		vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eSampledImage | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+		return format != vk::Format::eUndefined && (physicalDevice.getFormatProperties(format).optimalTilingFeatures & required) == required;
+	}
+
+	TextureData loadTextureData() {
+		TextureData texture;
+
+		for (const auto& path : COMPRESSED_TEXTURE_PATHS) {
+			if (!texture.container.open(path))
+				continue;
+
+			bool parsed = path.size() > 4 && path.compare(path.size() - 4, 4, ".dds") == 0 ?
+				parseDds(texture.container, texture) : parseKtx2(texture.container, texture);
+			if (parsed && canSampleTextureFormat(texture.format))
+				return texture;
+
+			std::cerr << path << " is malformed or in a format this device can't sample, skipping it" << std::endl;
+			texture.container.close();
+		}
+
+		int texWidth, texHeight, texChannels;
+		stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		if (!pixels)
+			throw std::runtime_error("failed to load texture image!");
+
+		size_t imageSize = static_cast<size_t>(texWidth) * static_cast<size_t>(texHeight) * 4;
+		texture.pixels.assign(pixels, pixels + imageSize);
+		stbi_image_free(pixels);
+
+		texture.format = vk::Format::eR8G8B8A8Unorm;
+		texture.levels.push_back({0, imageSize, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight)});
+		if (options.streamTextures)
+			generateMipChain(texture);
+		return texture;
+	}
+
+	//the model doesn't depend on the device at all, so it can start before the instance is even created
+	void startModelLoad() {
+		modelLoad = workers->submit([this](uint32_t) { loadModel(); });
+	}
+
+	void waitForModel() {
+		modelLoad.get();
+	}
+
+	//needs the physical device to know which compressed formats can be sampled
+	void startTextureLoad() {
+		textureLoad = workers->submit([this](uint32_t) { return loadTextureData(); });
+	}
+
+	void createTextureImage() {
+		TextureData texture = textureLoad.get();
+		textureFormat = texture.format;
+
+		if (textureStreaming) {
+			startTextureStreaming(std::move(texture));
+			return;
+		}
+
+		//a decoded image only has its top level, the rest of the chain is blitted on the gpu
+		bool generateMips = texture.levels.size() == 1 && texture.format == vk::Format::eR8G8B8A8Unorm;
+		uint32_t texWidth = texture.levels[0].width;
+		uint32_t texHeight = texture.levels[0].height;
+		mipLevels = generateMips ?
+			static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1 :
+			static_cast<uint32_t>(texture.levels.size());
+
+		std::vector<vk::BufferImageCopy> regions;
+		vk::UniqueBuffer stagingBuffer;
+		UniqueAllocation stagingBufferMemory;
+		stageTextureLevels(texture, 0, regions, stagingBuffer, stagingBufferMemory);
+
+		vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+		if (generateMips)
+			usage |= vk::ImageUsageFlagBits::eTransferSrc;
+
+		createImage(
+			texWidth, texHeight, mipLevels, vk::SampleCountFlagBits::e1, textureFormat, vk::ImageTiling::eOptimal,
+			usage, vk::MemoryPropertyFlagBits::eDeviceLocal, textureImage, textureImageMemory
+		);
+
+		transitionImageLayout(textureImage.get(), textureFormat, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, mipLevels);
+		copyBufferToImage(stagingBuffer.get(), textureImage.get(), regions);
+		transferImageOwnership(textureImage.get(), vk::ImageLayout::eTransferDstOptimal, mipLevels);
+		keepUntilUploaded(std::move(stagingBuffer), std::move(stagingBufferMemory));
+
+		if (generateMips) {
+			//transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
+			generateMipmaps(textureImage.get(), textureFormat, texWidth, texHeight, mipLevels);
+		} else {
+			transitionImageLayout(textureImage.get(), textureFormat, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, mipLevels);
+		}
+	}
+
+	//copies levels firstLevel and up into a staging buffer, with regions that put firstLevel at mip 0 of the image.
+	//buffer offsets of a copy have to be a multiple of the texel block size, 16 covers every format we load
+	void stageTextureLevels(
+			const TextureData& texture, uint32_t firstLevel, std::vector<vk::BufferImageCopy>& regions,
+			vk::UniqueBuffer& stagingBuffer, UniqueAllocation& stagingBufferMemory) {
+		vk::DeviceSize imageSize = 0;
+		for (uint32_t i = firstLevel; i < texture.levels.size(); ++i) {
+			vk::BufferImageCopy region = {};
+			region.bufferOffset = imageSize;
+			region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+			region.imageSubresource.mipLevel = i - firstLevel;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = {texture.levels[i].width, texture.levels[i].height, 1};
+			regions.push_back(region);
+
+			imageSize = (imageSize + texture.levels[i].size + 15) / 16 * 16;
+		}
+
+		createBuffer(
+			imageSize, vk::BufferUsageFlagBits::eTransferSrc, 
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			stagingBuffer, stagingBufferMemory, MemoryPoolKind::eTransient
+		);
+
+		for (uint32_t i = firstLevel; i < texture.levels.size(); ++i) {
+			memcpy(
+				static_cast<uint8_t*>(stagingBufferMemory->mapped) + regions[i - firstLevel].bufferOffset,
+				texture.data() + texture.levels[i].offset, texture.levels[i].size
+			);
+		}
+	}
+
+	//only the mip tail goes up with the startup uploads, so the first frame doesn't wait for the full size levels
+	void startTextureStreaming(TextureData&& texture) {
+		streamingSource = std::move(texture);
+		textureLevelCount = static_cast<uint32_t>(streamingSource.levels.size());
+
+		textureTailLevel = textureLevelCount - 1;
+		for (uint32_t i = 0; i < textureLevelCount; ++i) {
+			if (std::max(streamingSource.levels[i].width, streamingSource.levels[i].height) <= TEXTURE_STREAMING_TAIL_SIZE) {
+				textureTailLevel = i;
+				break;
+			}
+		}
+
+		StreamedTextureImage tail = createStreamedTextureImage(textureTailLevel);
+		textureImage = std::move(tail.image);
+		textureImageMemory = std::move(tail.memory);
+		textureBaseLevel = textureTailLevel;
+		mipLevels = textureLevelCount - textureBaseLevel;
+	}
+
+	//records the upload into the current batch, the image may only be sampled once that batch has completed
+	StreamedTextureImage createStreamedTextureImage(uint32_t baseLevel) {
+		StreamedTextureImage streamed;
+		streamed.baseLevel = baseLevel;
+		uint32_t levelCount = textureLevelCount - baseLevel;
+
+		std::vector<vk::BufferImageCopy> regions;
+		vk::UniqueBuffer stagingBuffer;
+		UniqueAllocation stagingBufferMemory;
+		stageTextureLevels(streamingSource, baseLevel, regions, stagingBuffer, stagingBufferMemory);
+
+		createImage(
+			streamingSource.levels[baseLevel].width, streamingSource.levels[baseLevel].height, levelCount, vk::SampleCountFlagBits::e1,
+			textureFormat, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+			vk::MemoryPropertyFlagBits::eDeviceLocal, streamed.image, streamed.memory
+		);
+
+		transitionImageLayout(streamed.image.get(), textureFormat, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, levelCount);
+		copyBufferToImage(stagingBuffer.get(), streamed.image.get(), regions);
+		transferImageOwnership(streamed.image.get(), vk::ImageLayout::eTransferDstOptimal, levelCount);
+		keepUntilUploaded(std::move(stagingBuffer), std::move(stagingBufferMemory));
+		transitionImageLayout(streamed.image.get(), textureFormat, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, levelCount);
+
+		return streamed;
+	}
+
+	vk::DeviceSize getStreamedLevelsSize(uint32_t baseLevel) {
+		vk::DeviceSize size = 0;
+		for (uint32_t i = baseLevel; i < textureLevelCount; ++i)
+			size += streamingSource.levels[i].size;
+		return size;
+	}
+
+	//the finest level worth having for the size the model covers on screen, assuming its texture is spread across it once
+	uint32_t getTextureDemandLevel() {
+		float texels = static_cast<float>(std::max(streamingSource.levels[0].width, streamingSource.levels[0].height));
+		float texelsPerPixel = texels / std::max(textureDemandPixels, 1.0f);
+		uint32_t level = texelsPerPixel > 1.0f ? static_cast<uint32_t>(std::floor(std::log2(texelsPerPixel))) : 0;
+		return std::min(level, textureTailLevel);
+	}
+
+	//what the texture may occupy: the heap's budget that nobody else is using plus what it already has, with some headroom
+	vk::DeviceSize getTextureBudget() {
+		vk::DeviceSize budget = options.textureBudget > 0 ?
+			static_cast<vk::DeviceSize>(options.textureBudget) * 1024 * 1024 : std::numeric_limits<vk::DeviceSize>::max();
+
+		if (memoryBudget) {
+			auto properties = physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+			const auto& memoryProperties = properties.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+			const auto& heapBudget = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+
+			uint32_t heap = memoryProperties.memoryTypes[textureImageMemory->memoryTypeIndex].heapIndex;
+			vk::DeviceSize available = heapBudget.heapBudget[heap] > heapBudget.heapUsage[heap] ? heapBudget.heapBudget[heap] - heapBudget.heapUsage[heap] : 0;
+			budget = std::min(budget, (available + textureImageMemory->size) / 10 * 9);
+		}
+
+		return budget;
+	}
+
+	//called once a frame, at most one change is uploading at a time and a finished one is swapped in here
+	void updateTextureResidency() {
+		if (!textureStreaming || ++framesSinceTextureSwap <= framesInFlight)
+			return;
+
+		//no frame in flight samples a retired texture any more, so its slot can take the next one
+		for (const auto& retired : retiredTextures) {
+			if (bindless)
+				freeBindlessTextureSlots.push_back(retired.bindlessSlot);
+		}
+		retiredTextures.clear();
+
+		if (streamingTexture) {
+			if (streamingTextureUploaded)
+				swapStreamedTexture();
+			return;
+		}
+
+		//evicting may drop straight to whatever fits, refining goes one level at a time so each step arrives as soon as it can
+		uint32_t target = getTextureDemandLevel();
+		vk::DeviceSize budget = getTextureBudget();
+		while (target < textureTailLevel && getStreamedLevelsSize(target) > budget)
+			++target;
+		if (target < textureBaseLevel)
+			target = textureBaseLevel - 1;
+		if (target == textureBaseLevel)
+			return;
+
+		//a swap needs a slot of its own while the frames in flight still sample the previous one
+		if (bindless && freeBindlessTextureSlots.empty() && bindlessTextureCount == bindlessTextureCapacity) {
+			std::cerr << "bindless texture array is full, not streaming the texture any further" << std::endl;
+			textureStreaming = false;
+			return;
+		}
+
+		streamingTexture = std::make_unique<StreamedTextureImage>(createStreamedTextureImage(target));
+		streamingTexture->view = createImageView(streamingTexture->image.get(), textureFormat, vk::ImageAspectFlagBits::eColor, textureLevelCount - target);
+		streamingTextureUploaded = false;
+		getUploadBatch().completionCallbacks.push_back([this]() { streamingTextureUploaded = true; });
+		submitUploads();
+	}
+
+	void swapStreamedTexture() {
+		StreamedTextureImage previous;
+		previous.memory = std::move(textureImageMemory);
+		previous.image = std::move(textureImage);
+		previous.view = std::move(textureImageView);
+		previous.baseLevel = textureBaseLevel;
+		previous.bindlessSlot = modelTextureIndex;
+		retiredTextures.push_back(std::move(previous));
+
+		textureImageMemory = std::move(streamingTexture->memory);
+		textureImage = std::move(streamingTexture->image);
+		textureImageView = std::move(streamingTexture->view);
+		textureBaseLevel = streamingTexture->baseLevel;
+		mipLevels = textureLevelCount - textureBaseLevel;
+		streamingTexture.reset();
+
+		//the swap only happens framesInFlight frames after the last one, so the slot it gets is sampled by no frame in flight
+		if (bindless) {
+			modelTextureIndex = addBindlessTexture(textureImageView.get());
+		} else {
+			writeDescriptorSet(spareDescriptorSet);
+			std::swap(descriptorSet, spareDescriptorSet);
+		}
+		framesSinceTextureSwap = 0;
+
+		if (options.profile) {
+			std::cout << "texture streamed to level " << textureBaseLevel << " (" << streamingSource.levels[textureBaseLevel].width << "x"
+				<< streamingSource.levels[textureBaseLevel].height << ")" << std::endl;
+		}
+	}
+
+	void generateMipmaps(vk::Image image, vk::Format imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
+		//blits need a graphics queue
+		vk::CommandBuffer commandBuffer = getGraphicsUploadCommands();
+
+		vk::FormatProperties formatProperties = physicalDevice.getFormatProperties(imageFormat);
+		if (!(formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear))
+			throw std::runtime_error("texture image format does not support linear blittings!");
+
+		vk::ImageMemoryBarrier barrier = {};
+		barrier.image = image;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
 		barrier.subresourceRange.levelCount = 1;
 
-		int32_t mipWidth = texWidth;
-		int32_t mipHeight = texHeight;
+		int32_t mipWidth = texWidth;
+		int32_t mipHeight = texHeight;
+
+		for (uint32_t i = 1; i < mipLevels; i++) {
+			barrier.subresourceRange.baseMipLevel = i - 1;
+			barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+			barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+
+			commandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(),
+				nullptr, nullptr, barrier
+			);
+
+			vk::ImageBlit blit = {};
+			blit.srcOffsets[0] = {0, 0, 0};
+			blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
+			blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+			blit.srcSubresource.mipLevel = i - 1;
+			blit.srcSubresource.baseArrayLayer = 0;
+			blit.srcSubresource.layerCount = 1;
+			blit.dstOffsets[0] = {0, 0, 0};
+			blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
+			blit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+			blit.dstSubresource.mipLevel = i;
+			blit.dstSubresource.baseArrayLayer = 0;
+			blit.dstSubresource.layerCount = 1;
+
+			commandBuffer.blitImage(
+				image, vk::ImageLayout::eTransferSrcOptimal,
+				image, vk::ImageLayout::eTransferDstOptimal,
+				blit, vk::Filter::eLinear
+			);
+
+			barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+			barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+			commandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(),
+				nullptr, nullptr, barrier
+			);
+
+			if (mipWidth > 1) mipWidth /= 2;
+			if (mipHeight > 1) mipHeight /= 2;
+		}
+
+		barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+		barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(),
+			nullptr, nullptr, barrier
+		);
+
+	}
+
+	void createTextureImageView() {
+		textureImageView = createImageView(textureImage.get(), textureFormat, vk::ImageAspectFlagBits::eColor, mipLevels);
+	}
+
+	void createTextureSampler() {
+		vk::SamplerCreateInfo samplerInfo = {};
+		samplerInfo.magFilter = vk::Filter::eLinear;
+		samplerInfo.minFilter = vk::Filter::eLinear;
+		samplerInfo.addressModeU = vk::SamplerAddressMode::eRepeat;
+		samplerInfo.addressModeV = vk::SamplerAddressMode::eRepeat;
+		samplerInfo.addressModeW = vk::SamplerAddressMode::eRepeat;
+		samplerInfo.anisotropyEnable = true;
+		samplerInfo.maxAnisotropy = 16;
+		samplerInfo.borderColor = vk::BorderColor::eIntOpaqueBlack;
+		samplerInfo.unnormalizedCoordinates = false;
+		samplerInfo.compareEnable = false;
+		samplerInfo.compareOp = vk::CompareOp::eAlways;
+		samplerInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
+		samplerInfo.mipLodBias = 0.0f;
+		samplerInfo.minLod = 0.0f;
+		//a streamed texture's views gain levels over time, the view limits the lod anyway
+		samplerInfo.maxLod = static_cast<float>(textureStreaming ? textureLevelCount : mipLevels);
+
+		textureSampler = device->createSamplerUnique(samplerInfo);
+	}
+
+	vk::UniqueImageView createImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels) {
+		vk::ImageViewCreateInfo viewInfo = {};
+		viewInfo.image = image;
+		viewInfo.viewType = vk::ImageViewType::e2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange.aspectMask = aspectFlags;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = mipLevels;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		return device->createImageViewUnique(viewInfo);
+	}
+
+	void createImage(
+			uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits numSamples, vk::Format format, vk::ImageTiling tiling,
+			vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::UniqueImage& image, UniqueAllocation& imageMemory,
+			vk::MemoryPropertyFlags preferredProperties = vk::MemoryPropertyFlags()) {
+
+		vk::ImageCreateInfo imageInfo = {};
+		imageInfo.imageType = vk::ImageType::e2D;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = format;
+		imageInfo.tiling = tiling;
+		imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+		imageInfo.usage = usage;
+		imageInfo.sharingMode = vk::SharingMode::eExclusive;
+		imageInfo.samples = numSamples;
+		imageInfo.mipLevels = mipLevels;
+
+		image = device->createImageUnique(imageInfo);
+
+		vk::MemoryRequirements memRequirements = device->getImageMemoryRequirements(image.get());
+
+		imageMemory = allocator.allocate(
+			memRequirements, findMemoryType(memRequirements.memoryTypeBits, properties, preferredProperties), MemoryPoolKind::eImage
+		);
+
+		device->bindImageMemory(image.get(), imageMemory->memory, imageMemory->offset);
+	}
+
+	void transitionImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels) {
+		vk::ImageMemoryBarrier barrier = {};
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		vk::PipelineStageFlags sourceStage;
+		vk::PipelineStageFlags destinationStage;
+		vk::CommandBuffer commandBuffer;
+
+		if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal) {
+			barrier.srcAccessMask = vk::AccessFlags();
+			barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+			sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
+			destinationStage = vk::PipelineStageFlagBits::eTransfer;
+			commandBuffer = getUploadBatch().transferCommands.get();
+		} else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal) {
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+
+			sourceStage = vk::PipelineStageFlagBits::eTransfer;
+			destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
+			//fragment shader stages only exist on the graphics queue, so this must follow transferImageOwnership()
+			commandBuffer = getGraphicsUploadCommands();
+		} else {
+			throw std::invalid_argument("unsupported layout transition!");
+		}
+
+		commandBuffer.pipelineBarrier(sourceStage, destinationStage, vk::DependencyFlags(), nullptr, nullptr, barrier);
+	}
+
+	void copyBufferToImage(vk::Buffer buffer, vk::Image image, const std::vector<vk::BufferImageCopy>& regions) {
+		getUploadBatch().transferCommands->copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal, regions);
+	}
+
+	void loadModel() {
+		if (options.streamMesh) {
+			scanStreamedModel();
+			return;
+		}
+
+		if (loadModelCache())
+			return;
+
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		std::string warn, err;
+
+		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str()))
+			throw std::runtime_error(warn + err);
+
+		size_t totalIndices = 0;
+		for (const auto& shape : shapes)
+			totalIndices += shape.mesh.indices.size();
+		indices.reserve(totalIndices);
+
+		auto makeVertex = [&attrib](const tinyobj::index_t& index) {
+			Vertex vertex = {};
+
+			vertex.pos = {
+				attrib.vertices[3 * index.vertex_index + 0],
+				attrib.vertices[3 * index.vertex_index + 1],
+				attrib.vertices[3 * index.vertex_index + 2]
+			};
+
+			vertex.texCoord = {
+				attrib.texcoords[2 * index.texcoord_index + 0],
+				1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+			};
+
+			return vertex;
+		};
+
+		if (shapes.size() > 1 && workers->size() > 1) {
+			//every shape is deduplicated on its own, then the per shape vertices are merged in shape order,
+			//which hands out the same indices as the serial loop below
+			std::vector<std::vector<Vertex>> shapeVertices(shapes.size());
+			std::vector<std::vector<uint32_t>> shapeIndices(shapes.size());
+
+			workers->parallelFor(static_cast<uint32_t>(shapes.size()), [&](uint32_t i, uint32_t) {
+				const auto& shapeIndexList = shapes[i].mesh.indices;
+				VertexDeduplicator uniqueVertices(shapeIndexList.size());
+				shapeIndices[i].reserve(shapeIndexList.size());
+
+				for (const auto& index : shapeIndexList)
+					shapeIndices[i].push_back(uniqueVertices.insert(makeVertex(index), shapeVertices[i]));
+			});
+
+			VertexDeduplicator uniqueVertices(totalIndices);
+			std::vector<uint32_t> remap;
+			for (size_t i = 0; i < shapes.size(); ++i) {
+				remap.resize(shapeVertices[i].size());
+				for (size_t v = 0; v < shapeVertices[i].size(); ++v)
+					remap[v] = uniqueVertices.insert(shapeVertices[i][v], vertices);
+
+				Submesh submesh = {};
+				submesh.firstIndex = static_cast<uint32_t>(indices.size());
+				for (uint32_t index : shapeIndices[i])
+					indices.push_back(remap[index]);
+
+				submesh.indexCount = static_cast<uint32_t>(indices.size()) - submesh.firstIndex;
+				if (submesh.indexCount > 0)
+					submeshes.push_back(submesh);
+			}
+		} else {
+			VertexDeduplicator uniqueVertices(totalIndices);
+
+			for (const auto& shape : shapes) {
+				Submesh submesh = {};
+				submesh.firstIndex = static_cast<uint32_t>(indices.size());
+
+				for (const auto& index : shape.mesh.indices)
+					indices.push_back(uniqueVertices.insert(makeVertex(index), vertices));
+
+				submesh.indexCount = static_cast<uint32_t>(indices.size()) - submesh.firstIndex;
+				if (submesh.indexCount > 0)
+					submeshes.push_back(submesh);
+			}
+		}
+
+		generateLods();
+		if (options.optimizeMesh)
+			optimizeModel();
+
+		vertexData = vertices.data();
+		indexData = indices.data();
+		vertexCount = static_cast<uint32_t>(vertices.size());
+		indexCount = static_cast<uint32_t>(indices.size());
+
+		writeModelCache();
+	}
+
+	//the first pass of --stream-mesh, which runs before there is a device: reads the attributes and counts the triangles
+	void scanStreamedModel() {
+		if (!streamedModelFile.open(MODEL_PATH))
+			throw std::runtime_error("failed to open " + MODEL_PATH);
+		if (options.optimizeMesh)
+			std::cerr << "a streamed mesh can't be optimised, loading it as it is" << std::endl;
+
+		const char* p = reinterpret_cast<const char*>(streamedModelFile.data());
+		const char* end = p + streamedModelFile.size();
+
+		while (p < end) {
+			const char* line = skipObjSpaces(p, end);
+			const char* lineEnd = findObjLineEnd(line, end);
+			p = lineEnd < end ? lineEnd + 1 : end;
+
+			if (isObjKeyword(line, lineEnd, "v")) {
+				glm::vec3 position;
+				const char* q = line + 1;
+				if (!parseObjFloat(q, lineEnd, position.x) || !parseObjFloat(q, lineEnd, position.y) || !parseObjFloat(q, lineEnd, position.z))
+					throw std::runtime_error("malformed vertex in " + MODEL_PATH);
+				streamedPositions.push_back(position);
+				streamedMinPosition = glm::min(streamedMinPosition, position);
+				streamedMaxPosition = glm::max(streamedMaxPosition, position);
+			} else if (isObjKeyword(line, lineEnd, "vt")) {
+				glm::vec2 texCoord;
+				const char* q = line + 2;
+				if (!parseObjFloat(q, lineEnd, texCoord.x) || !parseObjFloat(q, lineEnd, texCoord.y))
+					throw std::runtime_error("malformed texture coordinate in " + MODEL_PATH);
+				texCoord.y = 1.0f - texCoord.y;
+				streamedTexCoords.push_back(texCoord);
+				streamedMinTexCoord = glm::min(streamedMinTexCoord, texCoord);
+				streamedMaxTexCoord = glm::max(streamedMaxTexCoord, texCoord);
+			} else if (isObjKeyword(line, lineEnd, "f")) {
+				uint32_t corners = 0;
+				ObjCorner corner;
+				const char* q = line + 1;
+				while (skipObjSpaces(q, lineEnd) < lineEnd && parseObjCorner(q, lineEnd, corner))
+					++corners;
+				if (corners >= 3)
+					streamedTriangleCount += corners - 2;
+			}
+		}
+
+		if (streamedPositions.empty())
+			throw std::runtime_error(MODEL_PATH + " has no vertices");
+		if (streamedTexCoords.empty()) {
+			streamedMinTexCoord = glm::vec2(0.0f);
+			streamedMaxTexCoord = glm::vec2(0.0f);
+		}
+		if (streamedTriangleCount * 3 > UINT32_MAX)
+			throw std::runtime_error(MODEL_PATH + " has too many triangles for 32-bit indices");
+	}
+
+	//the second pass of --stream-mesh, triangulates the faces and writes indices and then vertices through a fixed size
+	//staging buffer. vertices are deduplicated on their position and texture coordinate indices, which only takes
+	//a chain head per position and a few words per vertex instead of a copy of every vertex
+	void streamModel() {
+		vk::UniqueBuffer stagingBuffer;
+		UniqueAllocation stagingBufferMemory;
+		createBuffer(
+			MESH_STREAM_CHUNK_SIZE * 2, vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			stagingBuffer, stagingBufferMemory, MemoryPoolKind::eTransient
+		);
+
+		std::array<vk::Fence, 2> chunkFences = {};
+		uint32_t chunk = 0;
+		vk::DeviceSize chunkUsed = 0;
+		vk::Buffer destination;
+		vk::DeviceSize destinationOffset = 0;
+
+		//the batches stay in pendingUploads untouched until the first frame, so their fences outlive this function
+		auto flush = [&]() {
+			if (chunkUsed == 0)
+				return;
+
+			getUploadBatch().transferCommands->copyBuffer(stagingBuffer.get(), destination, vk::BufferCopy(chunk * MESH_STREAM_CHUNK_SIZE, destinationOffset, chunkUsed));
+			chunkFences[chunk] = getUploadBatch().fence.get();
+			submitUploads();
+
+			destinationOffset += chunkUsed;
+			chunk ^= 1;
+			chunkUsed = 0;
+			if (chunkFences[chunk])
+				device->waitForFences(1, &chunkFences[chunk], true, UINT64_MAX);
+		};
+		auto allocate = [&](vk::DeviceSize size) {
+			if (chunkUsed + size > MESH_STREAM_CHUNK_SIZE)
+				flush();
+			void* data = static_cast<uint8_t*>(stagingBufferMemory->mapped) + chunk * MESH_STREAM_CHUNK_SIZE + chunkUsed;
+			chunkUsed += size;
+			return data;
+		};
+
+		indexCount = static_cast<uint32_t>(streamedTriangleCount * 3);
+		createBuffer(
+			sizeof(uint32_t) * std::max(indexCount, 1u), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			indexBuffer, indexBufferMemory
+		);
+		destination = indexBuffer.get();
+
+		const uint32_t EMPTY = UINT32_MAX;
+		std::vector<uint32_t> positionFirstVertex(streamedPositions.size(), EMPTY);
+		std::vector<uint32_t> vertexNext, vertexPosition, vertexTexCoord;
+		auto findVertex = [&](uint32_t position, uint32_t texCoord) {
+			for (uint32_t v = positionFirstVertex[position]; v != EMPTY; v = vertexNext[v]) {
+				if (vertexTexCoord[v] == texCoord)
+					return v;
+			}
+
+			uint32_t v = static_cast<uint32_t>(vertexPosition.size());
+			vertexNext.push_back(positionFirstVertex[position]);
+			vertexPosition.push_back(position);
+			vertexTexCoord.push_back(texCoord);
+			positionFirstVertex[position] = v;
+			return v;
+		};
+
+		//a new object or group starts a new submesh, like the shapes the regular loader gets from tinyobj
+		Submesh submesh = {};
+		uint32_t writtenIndices = 0;
+		auto closeSubmesh = [&]() {
+			submesh.indexCount = writtenIndices - submesh.firstIndex;
+			if (submesh.indexCount > 0)
+				submeshes.push_back(submesh);
+			submesh.firstIndex = writtenIndices;
+		};
+
+		const char* p = reinterpret_cast<const char*>(streamedModelFile.data());
+		const char* end = p + streamedModelFile.size();
+		size_t definedPositions = 0, definedTexCoords = 0;
+		std::vector<uint32_t> faceVertices;
+
+		while (p < end) {
+			const char* line = skipObjSpaces(p, end);
+			const char* lineEnd = findObjLineEnd(line, end);
+			p = lineEnd < end ? lineEnd + 1 : end;
+
+			if (isObjKeyword(line, lineEnd, "v")) {
+				++definedPositions;
+			} else if (isObjKeyword(line, lineEnd, "vt")) {
+				++definedTexCoords;
+			} else if (isObjKeyword(line, lineEnd, "o") || isObjKeyword(line, lineEnd, "g")) {
+				closeSubmesh();
+			} else if (isObjKeyword(line, lineEnd, "f")) {
+				faceVertices.clear();
+				ObjCorner corner;
+				const char* q = line + 1;
+				while (skipObjSpaces(q, lineEnd) < lineEnd && parseObjCorner(q, lineEnd, corner)) {
+					uint32_t position = resolveObjIndex(corner.position, definedPositions);
+					if (position == EMPTY)
+						throw std::runtime_error("face without a vertex index in " + MODEL_PATH);
+					faceVertices.push_back(findVertex(position, resolveObjIndex(corner.texCoord, definedTexCoords)));
+				}
+
+				//fans out from the first corner, the same as tinyobj's triangulation
+				for (size_t i = 2; i < faceVertices.size(); ++i) {
+					uint32_t* triangle = static_cast<uint32_t*>(allocate(sizeof(uint32_t) * 3));
+					triangle[0] = faceVertices[0];
+					triangle[1] = faceVertices[i - 1];
+					triangle[2] = faceVertices[i];
+					writtenIndices += 3;
+				}
+			}
+		}
+		closeSubmesh();
+		flush();
+
+		vertexCount = static_cast<uint32_t>(vertexPosition.size());
+		setVertexBounds(streamedMinPosition, streamedMaxPosition, streamedMinTexCoord, streamedMaxTexCoord);
+
+		uint32_t stride = Vertex::getStride(vertexFormat);
+		createBuffer(
+			static_cast<vk::DeviceSize>(stride) * std::max(vertexCount, 1u), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			vertexBuffer, vertexBufferMemory
+		);
+		destination = vertexBuffer.get();
+		destinationOffset = 0;
+
+		const uint32_t VERTICES_PER_PACK = 4096;
+		std::vector<Vertex> pack(VERTICES_PER_PACK);
+		for (uint32_t first = 0; first < vertexCount; first += VERTICES_PER_PACK) {
+			uint32_t count = std::min(VERTICES_PER_PACK, vertexCount - first);
+			for (uint32_t i = 0; i < count; ++i) {
+				pack[i].pos = streamedPositions[vertexPosition[first + i]];
+				uint32_t texCoord = vertexTexCoord[first + i];
+				pack[i].texCoord = texCoord == EMPTY ? glm::vec2(0.0f) : streamedTexCoords[texCoord];
+			}
+			packVertexRange(pack.data(), count, allocate(static_cast<vk::DeviceSize>(stride) * count));
+		}
+		flush();
+
+		transferBufferOwnership(indexBuffer.get(), vk::PipelineStageFlagBits::eVertexInput, vk::AccessFlagBits::eIndexRead);
+		transferBufferOwnership(vertexBuffer.get(), vk::PipelineStageFlagBits::eVertexInput, vk::AccessFlagBits::eVertexAttributeRead);
+		keepUntilUploaded(std::move(stagingBuffer), std::move(stagingBufferMemory));
+
+		lodCount = 1;
+		streamedPositions = std::vector<glm::vec3>();
+		streamedTexCoords = std::vector<glm::vec2>();
+		streamedModelFile.close();
+	}
+
+	//every lod is another set of submeshes indexing into the same vertices, appended after the full detail ones
+	void generateLods() {
+		size_t baseSubmeshCount = submeshes.size();
+		size_t baseTriangles = indices.size() / 3;
+		std::vector<std::vector<uint32_t>> lodIndices(MESH_LOD_COUNT);
+		std::vector<std::vector<Submesh>> lodSubmeshes(MESH_LOD_COUNT);
+		std::vector<std::vector<uint32_t>> lodRemaps(MESH_LOD_COUNT);
+
+		//the lods are searched one after another so each one starts from what the last clustering pass measured
+		uint32_t probeResolution = LOD_GRID_MAX_RESOLUTION / 4;
+		size_t probeTriangles = 0;
+		for (uint32_t lod = 1; lod < MESH_LOD_COUNT; ++lod)
+			lodRemaps[lod] = findLodRemap(baseTriangles >> lod, probeResolution, probeTriangles);
+
+		workers->parallelFor(MESH_LOD_COUNT - 1, [&](uint32_t job, uint32_t) {
+			uint32_t lod = job + 1;
+
+			//submeshes that collapse completely keep their empty slot so every lod has the same layout
+			for (size_t i = 0; i < baseSubmeshCount; ++i) {
+				Submesh submesh = {};
+				submesh.firstIndex = static_cast<uint32_t>(lodIndices[lod].size());
+				remapTriangles(indices.data() + submeshes[i].firstIndex, submeshes[i].indexCount, lodRemaps[lod], &lodIndices[lod]);
+				submesh.indexCount = static_cast<uint32_t>(lodIndices[lod].size()) - submesh.firstIndex;
+				lodSubmeshes[lod].push_back(submesh);
+			}
+		});
+
+		for (uint32_t lod = 1; lod < MESH_LOD_COUNT; ++lod) {
+			uint32_t lodStart = static_cast<uint32_t>(indices.size());
+			indices.insert(indices.end(), lodIndices[lod].begin(), lodIndices[lod].end());
+			for (Submesh submesh : lodSubmeshes[lod]) {
+				submesh.firstIndex += lodStart;
+				submeshes.push_back(submesh);
+			}
+		}
+
+		if (options.profile) {
+			std::cout << "mesh lods: " << baseTriangles;
+			for (uint32_t lod = 1; lod < MESH_LOD_COUNT; ++lod)
+				std::cout << " / " << lodIndices[lod].size() / 3;
+			std::cout << " triangles" << std::endl;
+		}
+
+		lodCount = MESH_LOD_COUNT;
+	}
+
+	//finds the finest grid that leaves at most targetTriangles, to within a few percent. triangle counts fall roughly with
+	//the square of the grid resolution, so every probe predicts the next one from what the last one measured, while the
+	//probes that passed and failed bracket it. the last probe is passed back in and out to seed the next lod's search
+	std::vector<uint32_t> findLodRemap(size_t targetTriangles, uint32_t& probeResolution, size_t& probeTriangles) {
+		//a single cell collapses everything, so it always meets the target
+		uint32_t passing = 1, failing = LOD_GRID_MAX_RESOLUTION + 1;
+		std::vector<uint32_t> passingRemap;
+
+		uint32_t resolution = probeResolution;
+		if (probeTriangles > 0)
+			resolution = static_cast<uint32_t>(std::lround(probeResolution * std::sqrt(static_cast<double>(targetTriangles) / probeTriangles)));
+
+		for (uint32_t probe = 0; probe < LOD_SEARCH_PROBES && failing - passing > std::max(1u, passing / 16); ++probe) {
+			//a prediction outside the bracket falls back to bisecting it
+			if (resolution <= passing || resolution >= failing)
+				resolution = passing + (failing - passing) / 2;
+
+			std::vector<uint32_t> remap = clusterVertices(vertices.data(), vertices.size(), resolution);
+			size_t triangles = remapTriangles(indices.data(), indices.size(), remap, nullptr);
+			probeResolution = resolution;
+			probeTriangles = triangles;
+
+			if (triangles <= targetTriangles) {
+				passing = resolution;
+				passingRemap = std::move(remap);
+				if (triangles >= targetTriangles - targetTriangles / 16)
+					break;
+			} else {
+				failing = resolution;
+			}
+
+			resolution = static_cast<uint32_t>(std::lround(resolution * std::sqrt(static_cast<double>(targetTriangles) / std::max<size_t>(triangles, 1))));
+		}
+
+		if (passingRemap.empty())
+			passingRemap = clusterVertices(vertices.data(), vertices.size(), passing);
+		return passingRemap;
+	}
+
+	size_t getLodSubmeshCount() {
+		return submeshes.size() / lodCount;
+	}
+
+	//triangles are only reordered within their submesh, so the draw list stays valid
+	void optimizeModel() {
+		float acmrBefore = computeAcmr(indices.data(), indices.size(), vertices.size());
+
+		workers->parallelFor(static_cast<uint32_t>(submeshes.size()), [&](uint32_t i, uint32_t) {
+			optimizeSubmesh(indices.data() + submeshes[i].firstIndex, submeshes[i].indexCount, vertices.data());
+		});
+
+		optimizeVertexFetch(vertices, indices);
+
+		float acmrAfter = computeAcmr(indices.data(), indices.size(), vertices.size());
+		std::cout << "mesh optimisation: ACMR " << acmrBefore << " -> " << acmrAfter
+			<< " (" << ACMR_CACHE_SIZE << " entry FIFO)" << std::endl;
+	}
+
+	bool getFileStamp(const std::string& filename, uint64_t& size, int64_t& modifiedTime) {
+		std::error_code ec;
+		size = std::filesystem::file_size(filename, ec);
+		if (ec)
+			return false;
+
+		modifiedTime = static_cast<int64_t>(std::filesystem::last_write_time(filename, ec).time_since_epoch().count());
+		return !ec;
+	}
+
+	uint64_t hashFile(const std::string& filename) {
+		MappedFile file;
+		if (!file.open(filename))
+			throw std::runtime_error("failed to map " + filename + "!");
+
+		return hashBytes(file.data(), file.size());
+	}
+
+	bool loadModelCache() {
+		uint64_t sourceSize;
+		int64_t sourceModifiedTime;
+		if (!getFileStamp(MODEL_PATH, sourceSize, sourceModifiedTime))
+			return false;
+
+		if (!modelCacheFile.open(MODEL_CACHE_PATH))
+			return false;
+
+		MeshCacheHeader header = {};
+		bool valid = modelCacheFile.size() >= sizeof(header);
+		if (valid) {
+			memcpy(&header, modelCacheFile.data(), sizeof(header));
+			valid = header.magic == MESH_CACHE_MAGIC && header.version == MESH_CACHE_VERSION &&
+				header.vertexStride == sizeof(Vertex) && header.sourceSize == sourceSize &&
+				(!options.optimizeMesh || (header.flags & MESH_CACHE_OPTIMIZED)) &&
+				header.lodCount == MESH_LOD_COUNT && header.submeshCount % header.lodCount == 0 &&
+				header.vertexCount <= UINT32_MAX && header.indexCount <= UINT32_MAX &&
+				modelCacheFile.size() == sizeof(header) + header.vertexCount * sizeof(Vertex) + header.indexCount * sizeof(uint32_t) +
+					header.submeshCount * sizeof(Submesh);
+		}
+
+		//the timestamp changes on checkouts and copies, so only trust it to skip hashing
+		if (valid && header.sourceModifiedTime != sourceModifiedTime)
+			valid = header.sourceHash == hashFile(MODEL_PATH);
+
+		if (!valid) {
+			modelCacheFile.close();
+			return false;
+		}
+
+		vertexData = reinterpret_cast<const Vertex*>(modelCacheFile.data() + sizeof(header));
+		indexData = reinterpret_cast<const uint32_t*>(vertexData + header.vertexCount);
+		vertexCount = static_cast<uint32_t>(header.vertexCount);
+		indexCount = static_cast<uint32_t>(header.indexCount);
+
+		const Submesh* submeshData = reinterpret_cast<const Submesh*>(indexData + header.indexCount);
+		submeshes.assign(submeshData, submeshData + header.submeshCount);
+		lodCount = header.lodCount;
+
+		return true;
+	}
+
+	void writeModelCache() {
+		MeshCacheHeader header = {};
+		header.magic = MESH_CACHE_MAGIC;
+		header.version = MESH_CACHE_VERSION;
+		header.vertexStride = sizeof(Vertex);
+		header.vertexCount = vertexCount;
+		header.indexCount = indexCount;
+		header.submeshCount = static_cast<uint32_t>(submeshes.size());
+		header.lodCount = lodCount;
+		header.flags = options.optimizeMesh ? MESH_CACHE_OPTIMIZED : 0;
+		if (!getFileStamp(MODEL_PATH, header.sourceSize, header.sourceModifiedTime))
+			return;
+		header.sourceHash = hashFile(MODEL_PATH);
+
+		//write to a temporary file first so an interrupted run never leaves a truncated cache behind
+		std::string tempPath = MODEL_CACHE_PATH + ".tmp";
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			std::cerr << "failed to write model cache!" << std::endl;
+			return;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(vertexData), sizeof(Vertex) * vertexCount);
+		file.write(reinterpret_cast<const char*>(indexData), sizeof(uint32_t) * indexCount);
+		file.write(reinterpret_cast<const char*>(submeshes.data()), sizeof(Submesh) * submeshes.size());
+		file.close();
+
+		std::error_code ec;
+		if (file.fail())
+			std::filesystem::remove(tempPath, ec);
+		else
+			std::filesystem::rename(tempPath, MODEL_CACHE_PATH, ec);
+
+		if (file.fail() || ec)
+			std::cerr << "failed to write model cache!" << std::endl;
+	}
+
+	void chooseVertexFormat() {
+		vertexFormat = options.vertexFormat;
+
+		for (const auto& attribute : Vertex::getAttributeDescriptions(vertexFormat)) {
+			if (!(physicalDevice.getFormatProperties(attribute.format).bufferFeatures & vk::FormatFeatureFlagBits::eVertexBuffer)) {
+				std::cerr << "vertex format " << vk::to_string(attribute.format) << " isn't supported, using full precision vertices" << std::endl;
+				vertexFormat = VertexFormat::eFull;
+				break;
+			}
+		}
+	}
+
+	//quantises straight into the staging buffer and sets up the transforms that undo it
+	void packVertices(void* destination) {
+		glm::vec3 minPosition(std::numeric_limits<float>::max());
+		glm::vec3 maxPosition(-std::numeric_limits<float>::max());
+		glm::vec2 minTexCoord(std::numeric_limits<float>::max());
+		glm::vec2 maxTexCoord(-std::numeric_limits<float>::max());
+		for (uint32_t i = 0; i < vertexCount; ++i) {
+			minPosition = glm::min(minPosition, vertexData[i].pos);
+			maxPosition = glm::max(maxPosition, vertexData[i].pos);
+			minTexCoord = glm::min(minTexCoord, vertexData[i].texCoord);
+			maxTexCoord = glm::max(maxTexCoord, vertexData[i].texCoord);
+		}
+
+		setVertexBounds(minPosition, maxPosition, minTexCoord, maxTexCoord);
+		packVertexRange(vertexData, vertexCount, destination);
+	}
+
+	void setVertexBounds(glm::vec3 minPosition, glm::vec3 maxPosition, glm::vec2 minTexCoord, glm::vec2 maxTexCoord) {
+		//sizes the instance grid, measured from the origin since that is what the model rotates around
+		meshRadius = std::max(glm::length(glm::max(glm::abs(minPosition), glm::abs(maxPosition))), 1e-3f);
+
+		if (vertexFormat == VertexFormat::eFull)
+			return;
+
+		//keeps a flat axis from dividing by zero
+		glm::vec3 positionExtent = glm::max(maxPosition - minPosition, glm::vec3(1e-6f));
+		glm::vec2 texCoordExtent = glm::max(maxTexCoord - minTexCoord, glm::vec2(1e-6f));
+		texCoordTransform = glm::vec4(texCoordExtent, minTexCoord);
+
+		//half floats are most precise around zero, so their positions are centred on the box
+		bool half = vertexFormat == VertexFormat::eHalf;
+		positionScale = half ? positionExtent * 0.5f : positionExtent;
+		positionOffset = half ? (minPosition + maxPosition) * 0.5f : minPosition;
+	}
+
+	//packs with the transforms setVertexBounds() chose, so a mesh can go out in as many pieces as it likes
+	void packVertexRange(const Vertex* source, uint32_t count, void* destination) {
+		if (vertexFormat == VertexFormat::eFull) {
+			memcpy(destination, source, sizeof(Vertex) * count);
+			return;
+		}
+
+		glm::vec2 texCoordExtent(texCoordTransform.x, texCoordTransform.y);
+		glm::vec2 minTexCoord(texCoordTransform.z, texCoordTransform.w);
+		bool half = vertexFormat == VertexFormat::eHalf;
+
+		PackedVertex* packed = static_cast<PackedVertex*>(destination);
+		for (uint32_t i = 0; i < count; ++i) {
+			glm::vec3 pos = (source[i].pos - positionOffset) / positionScale;
+			glm::vec2 texCoord = (source[i].texCoord - minTexCoord) / texCoordExtent;
+
+			for (int c = 0; c < 3; ++c)
+				packed[i].pos[c] = half ? glm::packHalf1x16(pos[c]) : glm::packUnorm1x16(pos[c]);
+			packed[i].pos[3] = 0;
+			for (int c = 0; c < 2; ++c)
+				packed[i].texCoord[c] = half ? glm::packHalf1x16(texCoord[c]) : glm::packUnorm1x16(texCoord[c]);
+		}
+	}
+
+	void createVertexBuffer() {
+		if (options.streamMesh) {
+			streamModel();
+			return;
+		}
+
+		vk::DeviceSize bufferSize = static_cast<vk::DeviceSize>(Vertex::getStride(vertexFormat)) * vertexCount;
+
+		vk::UniqueBuffer stagingBuffer;
+		UniqueAllocation stagingBufferMemory;
+		createBuffer(
+			bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			stagingBuffer, stagingBufferMemory, MemoryPoolKind::eTransient
+		);
+
+		packVertices(stagingBufferMemory->mapped);
+
+		createBuffer(
+			bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			vertexBuffer, vertexBufferMemory
+		);
+
+		copyBuffer(stagingBuffer.get(), vertexBuffer.get(), bufferSize);
+		transferBufferOwnership(vertexBuffer.get(), vk::PipelineStageFlagBits::eVertexInput, vk::AccessFlagBits::eVertexAttributeRead);
+		keepUntilUploaded(std::move(stagingBuffer), std::move(stagingBufferMemory));
+	}
+
+	void createIndexBuffer() {
+		//streamModel() already wrote it along with the vertex buffer
+		if (options.streamMesh)
+			return;
+
+		vk::DeviceSize bufferSize = sizeof(uint32_t) * indexCount;
+
+		vk::UniqueBuffer stagingBuffer;
+		UniqueAllocation stagingBufferMemory;
+		createBuffer(
+			bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			stagingBuffer, stagingBufferMemory, MemoryPoolKind::eTransient
+		);
+
+		memcpy(stagingBufferMemory->mapped, indexData, (size_t)bufferSize);
+
+		createBuffer(
+			bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			indexBuffer, indexBufferMemory
+		);
+
+		copyBuffer(stagingBuffer.get(), indexBuffer.get(), bufferSize);
+		transferBufferOwnership(indexBuffer.get(), vk::PipelineStageFlagBits::eVertexInput, vk::AccessFlagBits::eIndexRead);
+		keepUntilUploaded(std::move(stagingBuffer), std::move(stagingBufferMemory));
+	}
+
+	void createUniformBuffers() {
+		//every frame in flight gets its own slice of one persistently mapped buffer, selected with a dynamic offset
+		vk::DeviceSize alignment = physicalDevice.getProperties().limits.minUniformBufferOffsetAlignment;
+		uniformBufferStride = (sizeof(UniformBufferObject) + alignment - 1) / alignment * alignment;
+
+		createBuffer(
+			uniformBufferStride * framesInFlight, vk::BufferUsageFlagBits::eUniformBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			uniformBuffer, uniformBufferMemory
+		);
+
+		//the culling pass also reads each slice as a storage buffer, so they start on a storage offset boundary
+		instanceCount = options.instanceCount;
+		vk::DeviceSize storageAlignment = physicalDevice.getProperties().limits.minStorageBufferOffsetAlignment;
+		instanceSliceStride = (sizeof(glm::mat4) * instanceCount + storageAlignment - 1) / storageAlignment * storageAlignment;
+
+		vk::BufferUsageFlags instanceUsage = vk::BufferUsageFlagBits::eVertexBuffer;
+		if (gpuCulling)
+			instanceUsage |= vk::BufferUsageFlagBits::eStorageBuffer;
+		createBuffer(
+			instanceSliceStride * framesInFlight, instanceUsage,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			instanceBuffer, instanceBufferMemory
+		);
+
+		lodFirstInstance.assign(lodCount + 1, instanceCount);
+		lodFirstInstance[0] = 0;
+		if (lodCount > 1 && !gpuCulling) {
+			unsortedInstances.resize(instanceCount);
+			instanceLods.resize(instanceCount);
+		}
+	}
+
+	void createDescriptorPool() {
+		std::array<vk::DescriptorPoolSize, 2> poolSizes = {};
+		poolSizes[0].type = vk::DescriptorType::eUniformBufferDynamic;
+		poolSizes[0].descriptorCount = 1;
+		poolSizes[1].type = vk::DescriptorType::eCombinedImageSampler;
+		poolSizes[1].descriptorCount = 1;
+
+		//streaming swaps between two sets that only differ in the texture
+		uint32_t setCount = textureStreaming && !bindless ? 2 : 1;
+		poolSizes[0].descriptorCount *= setCount;
+		poolSizes[1].descriptorCount *= setCount;
+
+		vk::DescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.poolSizeCount = poolSizes.size();
+		poolInfo.pPoolSizes = poolSizes.data();
+		poolInfo.maxSets = setCount;
+
+		descriptorPool = device->createDescriptorPoolUnique(poolInfo);
+
+		if (bindless) {
+			std::array<vk::DescriptorPoolSize, 2> bindlessPoolSizes = {
+				vk::DescriptorPoolSize(vk::DescriptorType::eSampler, 1),
+				vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, bindlessTextureCapacity)
+			};
+
+			bindlessDescriptorPool = device->createDescriptorPoolUnique(
+				vk::DescriptorPoolCreateInfo(
+					bindlessUpdateAfterBind ? vk::DescriptorPoolCreateFlagBits::eUpdateAfterBindEXT : vk::DescriptorPoolCreateFlags(),
+					1, static_cast<uint32_t>(bindlessPoolSizes.size()), bindlessPoolSizes.data()
+				)
+			);
+		}
+	}
+
+	void createDescriptorSets() {
+		std::array<vk::DescriptorSetLayout, 2> setLayouts = {descriptorSetLayout.get(), descriptorSetLayout.get()};
+		vk::DescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.descriptorPool = descriptorPool.get();
+		allocInfo.descriptorSetCount = textureStreaming && !bindless ? 2 : 1;
+		allocInfo.pSetLayouts = setLayouts.data();
+
+		std::vector<vk::DescriptorSet> sets = device->allocateDescriptorSets(allocInfo);
+		descriptorSet = sets[0];
+		writeDescriptorSet(descriptorSet);
+		if (sets.size() > 1) {
+			spareDescriptorSet = sets[1];
+			writeDescriptorSet(spareDescriptorSet);
+		}
+
+		if (bindless) {
+			createBindlessDescriptorSet();
+			modelTextureIndex = addBindlessTexture(textureImageView.get());
+		}
+	}
+
+	void writeDescriptorSet(vk::DescriptorSet set) {
+		vk::DescriptorBufferInfo bufferInfo = {};
+		bufferInfo.buffer = uniformBuffer.get();
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(UniformBufferObject);
+
+		vk::DescriptorImageInfo imageInfo = {};
+		imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		imageInfo.imageView = textureImageView.get();
+		imageInfo.sampler = textureSampler.get();
+
+		std::array<vk::WriteDescriptorSet, 2> descriptorWrites = {};
+
+		descriptorWrites[0].dstSet = set;
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].dstArrayElement = 0;
+		descriptorWrites[0].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+		descriptorWrites[1].dstSet = set;
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].dstArrayElement = 0;
+		descriptorWrites[1].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].pImageInfo = &imageInfo;
+
+		//the bindless set has no binding 1, its textures are added one by one instead
+		device->updateDescriptorSets(bindless ? 1 : descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+	}
+
+	void createBindlessDescriptorSet() {
+		vk::DescriptorSetAllocateInfo allocInfo(bindlessDescriptorPool.get(), 1, &bindlessDescriptorSetLayout.get());
+		bindlessDescriptorSet = device->allocateDescriptorSets(allocInfo)[0];
 
-		for (uint32_t i = 1; i < mipLevels; i++) {
-			barrier.subresourceRange.baseMipLevel = i - 1;
-			barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-			barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
-			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-			barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+		vk::DescriptorImageInfo samplerInfo(textureSampler.get(), nullptr, vk::ImageLayout::eUndefined);
+		vk::WriteDescriptorSet samplerWrite(bindlessDescriptorSet, 0, 0, 1, vk::DescriptorType::eSampler, &samplerInfo, nullptr, nullptr);
+		device->updateDescriptorSets(samplerWrite, nullptr);
+	}
 
-			commandBuffers[0]->pipelineBarrier(
-				vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(),
-				nullptr, nullptr, barrier
-			);
+	//the only descriptor write a texture ever needs, draws that are already recorded keep using their own indices.
+	//while frames are in flight this needs update after bind or update unused while pending, and a slot none of them samples
+	uint32_t addBindlessTexture(vk::ImageView imageView) {
+		uint32_t slot;
+		if (!freeBindlessTextureSlots.empty()) {
+			slot = freeBindlessTextureSlots.back();
+			freeBindlessTextureSlots.pop_back();
+		} else {
+			if (bindlessTextureCount == bindlessTextureCapacity)
+				throw std::runtime_error("bindless texture array is full!");
+			slot = bindlessTextureCount++;
+		}
 
-			vk::ImageBlit blit = {};
-			blit.srcOffsets[0] = {0, 0, 0};
-			blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
-			blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-			blit.srcSubresource.mipLevel = i - 1;
-			blit.srcSubresource.baseArrayLayer = 0;
-			blit.srcSubresource.layerCount = 1;
-			blit.dstOffsets[0] = {0, 0, 0};
-			blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1};
-			blit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-			blit.dstSubresource.mipLevel = i;
-			blit.dstSubresource.baseArrayLayer = 0;
-			blit.dstSubresource.layerCount = 1;
+		vk::DescriptorImageInfo imageInfo(nullptr, imageView, vk::ImageLayout::eShaderReadOnlyOptimal);
+		vk::WriteDescriptorSet imageWrite(
+			bindlessDescriptorSet, 1, slot, 1, vk::DescriptorType::eSampledImage, &imageInfo, nullptr, nullptr
+		);
+		device->updateDescriptorSets(imageWrite, nullptr);
 
-			commandBuffers[0]->blitImage(
-				image, vk::ImageLayout::eTransferSrcOptimal,
-				image, vk::ImageLayout::eTransferDstOptimal,
-				blit, vk::Filter::eLinear
-			);
+		return slot;
+	}
 
-			barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
-			barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-			barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
-			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+	void createCullingResources() {
+		if (!gpuCulling)
+			return;
 
-			commandBuffers[0]->pipelineBarrier(
-				vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(),
-				nullptr, nullptr, barrier
+		vk::DeviceSize alignment = physicalDevice.getProperties().limits.minStorageBufferOffsetAlignment;
+		auto alignOffset = [&](vk::DeviceSize offset) {
+			return (offset + alignment - 1) / alignment * alignment;
+		};
+
+		cullLodCount = drawIndirectFirstInstance ? lodCount : 1;
+		cullDrawCapacity = static_cast<uint32_t>(getLodSubmeshCount()) * cullLodCount;
+		cullVisibleCountOffset = alignOffset(sizeof(uint32_t));
+		cullCommandsOffset = alignOffset(cullVisibleCountOffset + cullLodCount * sizeof(uint32_t));
+		cullVisibleInstancesOffset = alignOffset(cullCommandsOffset + cullDrawCapacity * sizeof(VkDrawIndexedIndirectCommand));
+		cullSliceStride = alignOffset(cullVisibleInstancesOffset + cullLodCount * instanceCount * sizeof(glm::mat4));
+
+		createBuffer(
+			cullSliceStride * framesInFlight,
+			vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+				vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+			vk::MemoryPropertyFlagBits::eDeviceLocal,
+			cullBuffer, cullBufferMemory
+		);
+
+		//the submeshes never change after loading, so their table is written once
+		vk::DeviceSize submeshTableSize = sizeof(Submesh) * submeshes.size();
+		createBuffer(
+			submeshTableSize, vk::BufferUsageFlagBits::eStorageBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+			submeshBuffer, submeshBufferMemory
+		);
+		memcpy(submeshBufferMemory->mapped, submeshes.data(), (size_t)submeshTableSize);
+
+		//plain storage buffers with a set per frame, devices only have to support 4 dynamic ones
+		std::array<vk::DescriptorSetLayoutBinding, 6> bindings;
+		for (uint32_t i = 0; i < bindings.size(); ++i)
+			bindings[i] = vk::DescriptorSetLayoutBinding(i, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute, nullptr);
+
+		cullDescriptorSetLayout = device->createDescriptorSetLayoutUnique(
+			vk::DescriptorSetLayoutCreateInfo(
+				vk::DescriptorSetLayoutCreateFlags(), static_cast<uint32_t>(bindings.size()), bindings.data()
+			)
+		);
+
+		vk::PushConstantRange pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullParameters));
+		cullPipelineLayout = device->createPipelineLayoutUnique(
+			vk::PipelineLayoutCreateInfo(
+				vk::PipelineLayoutCreateFlags(),
+				1, &cullDescriptorSetLayout.get(),
+				1, &pushConstantRange
+			)
+		);
+
+		if (hotReload)
+			watchShader(CULL_SHADER, true);
+		cullPipeline = buildCullPipeline(loadShaderCode(CULL_SHADER));
+
+		vk::DescriptorPoolSize poolSize(vk::DescriptorType::eStorageBuffer, static_cast<uint32_t>(bindings.size()) * framesInFlight);
+		cullDescriptorPool = device->createDescriptorPoolUnique(
+			vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlags(), framesInFlight, 1, &poolSize)
+		);
+
+		std::vector<vk::DescriptorSetLayout> layouts(framesInFlight, cullDescriptorSetLayout.get());
+		vk::DescriptorSetAllocateInfo allocInfo(cullDescriptorPool.get(), framesInFlight, layouts.data());
+		cullDescriptorSets = device->allocateDescriptorSets(allocInfo);
+
+		for (size_t i = 0; i < framesInFlight; ++i) {
+			vk::DeviceSize sliceOffset = i * cullSliceStride;
+			std::array<vk::DescriptorBufferInfo, 6> bufferInfos = {
+				vk::DescriptorBufferInfo(instanceBuffer.get(), i * instanceSliceStride, instanceCount * sizeof(glm::mat4)),
+				vk::DescriptorBufferInfo(cullBuffer.get(), sliceOffset, sizeof(uint32_t)),
+				vk::DescriptorBufferInfo(cullBuffer.get(), sliceOffset + cullVisibleCountOffset, cullLodCount * sizeof(uint32_t)),
+				vk::DescriptorBufferInfo(cullBuffer.get(), sliceOffset + cullCommandsOffset, cullDrawCapacity * sizeof(VkDrawIndexedIndirectCommand)),
+				vk::DescriptorBufferInfo(cullBuffer.get(), sliceOffset + cullVisibleInstancesOffset, cullLodCount * instanceCount * sizeof(glm::mat4)),
+				vk::DescriptorBufferInfo(submeshBuffer.get(), 0, submeshTableSize)
+			};
+
+			std::array<vk::WriteDescriptorSet, 6> descriptorWrites;
+			for (uint32_t binding = 0; binding < descriptorWrites.size(); ++binding) {
+				descriptorWrites[binding] = vk::WriteDescriptorSet(
+					cullDescriptorSets[i], binding, 0, 1, vk::DescriptorType::eStorageBuffer, nullptr, &bufferInfos[binding], nullptr
+				);
+			}
+
+			device->updateDescriptorSets(descriptorWrites, nullptr);
+		}
+	}
+
+	void createBuffer(
+			vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::UniqueBuffer& buffer, UniqueAllocation& bufferMemory,
+			MemoryPoolKind poolKind = MemoryPoolKind::eBuffer) {
+		vk::BufferCreateInfo bufferCreateInfo(
+			vk::BufferCreateFlags(), size,
+			usage, vk::SharingMode::eExclusive
+		);
+
+		buffer = device->createBufferUnique(bufferCreateInfo);
+
+		vk::MemoryRequirements memRequirements = device->getBufferMemoryRequirements(buffer.get());
+
+		bufferMemory = allocator.allocate(memRequirements, findMemoryType(memRequirements.memoryTypeBits, properties), poolKind);
+
+		device->bindBufferMemory(buffer.get(), bufferMemory->memory, bufferMemory->offset);
+	}
+
+	UploadBatch& getUploadBatch() {
+		if (uploadBatch)
+			return *uploadBatch;
+
+		uploadBatch = std::make_unique<UploadBatch>();
+
+		uploadBatch->transferCommands = std::move(device->allocateCommandBuffersUnique(
+			vk::CommandBufferAllocateInfo(
+				transferCommandPool.get(), vk::CommandBufferLevel::ePrimary, 1
+			)
+		)[0]);
+		uploadBatch->transferCommands->begin(
+			vk::CommandBufferBeginInfo(
+				vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr
+			)
+		);
+
+		if (transferQueueFamily != graphicsQueueFamily) {
+			uploadBatch->graphicsCommands = std::move(device->allocateCommandBuffersUnique(
+				vk::CommandBufferAllocateInfo(
+					uploadCommandPool.get(), vk::CommandBufferLevel::ePrimary, 1
+				)
+			)[0]);
+			uploadBatch->graphicsCommands->begin(
+				vk::CommandBufferBeginInfo(
+					vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr
+				)
 			);
+			uploadBatch->transferComplete = device->createSemaphoreUnique(vk::SemaphoreCreateInfo(vk::SemaphoreCreateFlags()));
+		}
 
-			if (mipWidth > 1) mipWidth /= 2;
-			if (mipHeight > 1) mipHeight /= 2;
+		uploadBatch->fence = device->createFenceUnique(vk::FenceCreateInfo(vk::FenceCreateFlags()));
+
+		return *uploadBatch;
+	}
+
+	vk::CommandBuffer getGraphicsUploadCommands() {
+		UploadBatch& batch = getUploadBatch();
+		return batch.graphicsCommands ? batch.graphicsCommands.get() : batch.transferCommands.get();
+	}
+
+	void keepUntilUploaded(vk::UniqueBuffer&& stagingBuffer, UniqueAllocation&& stagingBufferMemory) {
+		UploadBatch& batch = getUploadBatch();
+		batch.stagingBuffers.push_back(std::move(stagingBuffer));
+		batch.stagingMemory.push_back(std::move(stagingBufferMemory));
+	}
+
+	//hands a freshly written buffer to the graphics queue, or just makes the writes visible when both families are the same
+	void transferBufferOwnership(vk::Buffer buffer, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess) {
+		UploadBatch& batch = getUploadBatch();
+
+		vk::BufferMemoryBarrier barrier = {};
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+
+		if (transferQueueFamily == graphicsQueueFamily) {
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstAccessMask = dstAccess;
+			batch.transferCommands->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, dstStage, vk::DependencyFlags(), nullptr, barrier, nullptr);
+			return;
 		}
 
-		barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-		barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-		barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		barrier.srcQueueFamilyIndex = transferQueueFamily;
+		barrier.dstQueueFamilyIndex = graphicsQueueFamily;
+		batch.transferCommands->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), nullptr, barrier, nullptr);
+
+		barrier.srcAccessMask = vk::AccessFlags();
+		barrier.dstAccessMask = dstAccess;
+		batch.graphicsCommands->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, dstStage, vk::DependencyFlags(), nullptr, barrier, nullptr);
+	}
+
+	//after this, further work on the image must be recorded into the batch's graphicsCommands
+	void transferImageOwnership(vk::Image image, vk::ImageLayout layout, uint32_t mipLevels) {
+		if (transferQueueFamily == graphicsQueueFamily)
+			return;
+
+		UploadBatch& batch = getUploadBatch();
+
+		vk::ImageMemoryBarrier barrier = {};
+		barrier.oldLayout = layout;
+		barrier.newLayout = layout;
+		barrier.srcQueueFamilyIndex = transferQueueFamily;
+		barrier.dstQueueFamilyIndex = graphicsQueueFamily;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
 		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-		barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
 
-		commandBuffers[0]->pipelineBarrier(
-			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(),
-			nullptr, nullptr, barrier
+		batch.transferCommands->pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, vk::DependencyFlags(), nullptr, nullptr, barrier);
+
+		barrier.srcAccessMask = vk::AccessFlags();
+		barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite;
+		batch.graphicsCommands->pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), nullptr, nullptr, barrier);
+	}
+
+	//submits everything recorded since the last call without waiting; frames submitted afterwards are ordered behind it on the GPU
+	void submitUploads() {
+		if (!uploadBatch)
+			return;
+
+		uploadBatch->transferCommands->end();
+
+		if (!uploadBatch->graphicsCommands) {
+			transferQueue.submit(
+				vk::SubmitInfo(
+					0, nullptr, nullptr,
+					1, &uploadBatch->transferCommands.get(),
+					0, nullptr
+				), uploadBatch->fence.get()
+			);
+		} else {
+			uploadBatch->graphicsCommands->end();
+
+			transferQueue.submit(
+				vk::SubmitInfo(
+					0, nullptr, nullptr,
+					1, &uploadBatch->transferCommands.get(),
+					1, &uploadBatch->transferComplete.get()
+				), nullptr
+			);
+
+			vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+			graphicsQueue.submit(
+				vk::SubmitInfo(
+					1, &uploadBatch->transferComplete.get(), &waitStage,
+					1, &uploadBatch->graphicsCommands.get(),
+					0, nullptr
+				), uploadBatch->fence.get()
+			);
+		}
+
+		pendingUploads.push_back(std::move(uploadBatch));
+	}
+
+	//releases staging memory and command buffers of uploads the GPU has finished with
+	void retireUploads(bool wait) {
+		CpuScope scope("retireUploads");
+		//partition rather than remove_if, the completed batches still have callbacks to run
+		auto completed = std::partition(pendingUploads.begin(), pendingUploads.end(), [&](const std::unique_ptr<UploadBatch>& batch) {
+			if (wait)
+				device->waitForFences(1, &batch->fence.get(), true, UINT64_MAX);
+			return device->getFenceStatus(batch->fence.get()) != vk::Result::eSuccess;
+		});
+		for (auto batch = completed; batch != pendingUploads.end(); ++batch) {
+			for (const auto& callback : (*batch)->completionCallbacks)
+				callback();
+		}
+		pendingUploads.erase(completed, pendingUploads.end());
+	}
+
+	void copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size) {
+		vk::BufferCopy copyRegion(0, 0, size);
+		getUploadBatch().transferCommands->copyBuffer(srcBuffer, dstBuffer, copyRegion);
+	}
+
+	uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) {
+		vk::PhysicalDeviceMemoryProperties memProperties = physicalDevice.getMemoryProperties();
+
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+			if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+				return i;
+		}
+
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+
+	//prefers a type that also has the preferred properties, but settles for one that only has the required ones
+	uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties, vk::MemoryPropertyFlags preferredProperties) {
+		vk::PhysicalDeviceMemoryProperties memProperties = physicalDevice.getMemoryProperties();
+		vk::MemoryPropertyFlags wanted = properties | preferredProperties;
+
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+			if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & wanted) == wanted)
+				return i;
+		}
+
+		return findMemoryType(typeFilter, properties);
+	}
+
+	void createCommandBuffers() {
+		commandBuffers.resize(framesInFlight);
+
+		for (size_t i = 0; i < framesInFlight; ++i) {
+			commandBuffers[i] = std::move(device->allocateCommandBuffersUnique(
+				vk::CommandBufferAllocateInfo(
+					frameCommandPools[i].get(), vk::CommandBufferLevel::ePrimary, 1
+				)
+			)[0]);
+		}
+	}
+
+	vk::CommandBuffer getSecondaryCommandBuffer(size_t frame, uint32_t workerIndex) {
+		WorkerCommandPool& workerPool = workerCommandPools[frame][workerIndex];
+
+		if (workerPool.usedCommandBuffers == workerPool.secondaryCommandBuffers.size()) {
+			workerPool.secondaryCommandBuffers.push_back(std::move(device->allocateCommandBuffersUnique(
+				vk::CommandBufferAllocateInfo(
+					workerPool.pool.get(), vk::CommandBufferLevel::eSecondary, 1
+				)
+			)[0]));
+		}
+
+		return workerPool.secondaryCommandBuffers[workerPool.usedCommandBuffers++].get();
+	}
+
+	vk::UniquePipeline buildCullPipeline(const std::vector<char>& cullShaderCode) {
+		vk::UniqueShaderModule cullShaderModule = createShaderModule(cullShaderCode);
+
+		vk::ComputePipelineCreateInfo pipelineInfo(
+			vk::PipelineCreateFlags(),
+			vk::PipelineShaderStageCreateInfo(
+				vk::PipelineShaderStageCreateFlags(), vk::ShaderStageFlagBits::eCompute, cullShaderModule.get(), "main"
+			),
+			cullPipelineLayout.get()
+		);
+		return device->createComputePipelineUnique(pipelineCache.get(), pipelineInfo);
+	}
+
+	//zeroes the frame's counters, culls the instances into the visible list, then turns the visible count into draws
+	void recordCulling(vk::CommandBuffer commandBuffer, size_t frame) {
+		vk::DeviceSize sliceOffset = frame * cullSliceStride;
+
+		commandBuffer.fillBuffer(cullBuffer.get(), sliceOffset, cullCommandsOffset, 0);
+		cullBufferBarrier(
+			commandBuffer, frame,
+			vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader
+		);
+
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, cullPipeline.get());
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, cullPipelineLayout.get(), 0, cullDescriptorSets[frame], nullptr);
+
+		CullParameters parameters = {};
+		std::copy(frustumPlanes.begin(), frustumPlanes.end(), parameters.frustumPlanes);
+		parameters.instanceCount = instanceCount;
+		parameters.submeshCount = cullDrawCapacity;
+		parameters.radius = meshRadius;
+		parameters.lodDistance = lodDistance;
+		parameters.lodCount = cullLodCount;
+		parameters.compact = drawIndexedIndirectCountKHR != nullptr;
+
+		parameters.pass = 0;
+		commandBuffer.pushConstants(cullPipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(parameters), &parameters);
+		commandBuffer.dispatch((instanceCount + 63) / 64, 1, 1);
+		cullBufferBarrier(
+			commandBuffer, frame,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader
 		);
 
-		endSingleTimeCommands(commandBuffers);
+		parameters.pass = 1;
+		commandBuffer.pushConstants(cullPipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(parameters), &parameters);
+		commandBuffer.dispatch((cullDrawCapacity + 63) / 64, 1, 1);
+		cullBufferBarrier(
+			commandBuffer, frame,
+			vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eVertexAttributeRead,
+			vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput
+		);
 	}
 
-	void createTextureImageView() {
-		textureImageView = createImageView(textureImage.get(), vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor, mipLevels);
+	void cullBufferBarrier(
+			vk::CommandBuffer commandBuffer, size_t frame, vk::AccessFlags srcAccess, vk::AccessFlags dstAccess,
+			vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage) {
+		vk::BufferMemoryBarrier barrier(
+			srcAccess, dstAccess, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			cullBuffer.get(), frame * cullSliceStride, cullSliceStride
+		);
+		commandBuffer.pipelineBarrier(srcStage, dstStage, vk::DependencyFlags(), nullptr, barrier, nullptr);
 	}
 
-	void createTextureSampler() {
-		vk::SamplerCreateInfo samplerInfo = {};
-		samplerInfo.magFilter = vk::Filter::eLinear;
-		samplerInfo.minFilter = vk::Filter::eLinear;
-		samplerInfo.addressModeU = vk::SamplerAddressMode::eRepeat;
-		samplerInfo.addressModeV = vk::SamplerAddressMode::eRepeat;
-		samplerInfo.addressModeW = vk::SamplerAddressMode::eRepeat;
-		samplerInfo.anisotropyEnable = true;
-		samplerInfo.maxAnisotropy = 16;
-		samplerInfo.borderColor = vk::BorderColor::eIntOpaqueBlack;
-		samplerInfo.unnormalizedCoordinates = false;
-		samplerInfo.compareEnable = false;
-		samplerInfo.compareOp = vk::CompareOp::eAlways;
-		samplerInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
-		samplerInfo.mipLodBias = 0.0f;
-		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = static_cast<float>(mipLevels);
+	void recordDraws(vk::CommandBuffer commandBuffer, size_t frame, size_t firstSubmesh, size_t submeshCount) {
+		uint32_t uniformOffset = static_cast<uint32_t>(frame * uniformBufferStride);
+
+		//secondary command buffers inherit none of this state from the primary
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, getGraphicsPipeline(getPipelineVariant(!options.untextured, options.alphaTest)));
+		commandBuffer.setViewport(0, vk::Viewport(0.0f, 0.0f, (float) swapchainExtent.width, (float) swapchainExtent.height, 0.0f, 1.0f));
+		commandBuffer.setScissor(0, vk::Rect2D({0, 0}, swapchainExtent));
+		commandBuffer.bindIndexBuffer(indexBuffer.get(), 0, vk::IndexType::eUint32);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout.get(), 0, 1, &descriptorSet, 1, &uniformOffset);
+		//every submesh samples the model's one texture, so the index is pushed once for all the draws below
+		if (bindless) {
+			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout.get(), 1, bindlessDescriptorSet, nullptr);
+			commandBuffer.pushConstants(pipelineLayout.get(), vk::ShaderStageFlagBits::eFragment, 0, sizeof(modelTextureIndex), &modelTextureIndex);
+		}
 
-		textureSampler = device->createSamplerUnique(samplerInfo);
+		if (gpuCulling) {
+			recordCulledDraws(commandBuffer, frame);
+			return;
+		}
+
+		commandBuffer.bindVertexBuffers(0, {vertexBuffer.get(), instanceBuffer.get()}, {0, frame * instanceSliceStride});
+		for (uint32_t lod = 0; lod < lodCount; ++lod) {
+			uint32_t lodInstances = lodFirstInstance[lod + 1] - lodFirstInstance[lod];
+			if (lodInstances == 0)
+				continue;
+
+			for (size_t i = firstSubmesh; i < firstSubmesh + submeshCount; ++i) {
+				const Submesh& submesh = submeshes[lod * getLodSubmeshCount() + i];
+				if (submesh.indexCount > 0)
+					commandBuffer.drawIndexed(submesh.indexCount, lodInstances, submesh.firstIndex, 0, lodFirstInstance[lod]);
+			}
+		}
 	}
 
-	vk::UniqueImageView createImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels) {
-		vk::ImageViewCreateInfo viewInfo = {};
-		viewInfo.image = image;
-		viewInfo.viewType = vk::ImageViewType::e2D;
-		viewInfo.format = format;
-		viewInfo.subresourceRange.aspectMask = aspectFlags;
-		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = mipLevels;
-		viewInfo.subresourceRange.baseArrayLayer = 0;
-		viewInfo.subresourceRange.layerCount = 1;
+	//the instance transforms come from the visible list the culling pass wrote, the draws from its commands
+	void recordCulledDraws(vk::CommandBuffer commandBuffer, size_t frame) {
+		vk::DeviceSize sliceOffset = frame * cullSliceStride;
+		vk::DeviceSize commandsOffset = sliceOffset + cullCommandsOffset;
+		uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
 
-		return device->createImageViewUnique(viewInfo);
+		commandBuffer.bindVertexBuffers(0, {vertexBuffer.get(), cullBuffer.get()}, {0, sliceOffset + cullVisibleInstancesOffset});
+
+		if (drawIndexedIndirectCountKHR)
+			drawIndexedIndirectCountKHR(commandBuffer, cullBuffer.get(), commandsOffset, cullBuffer.get(), sliceOffset, cullDrawCapacity, stride);
+		else if (multiDrawIndirect)
+			commandBuffer.drawIndexedIndirect(cullBuffer.get(), commandsOffset, cullDrawCapacity, stride);
+		else {
+			for (uint32_t i = 0; i < cullDrawCapacity; ++i)
+				commandBuffer.drawIndexedIndirect(cullBuffer.get(), commandsOffset + i * stride, 1, stride);
+		}
 	}
 
-	void createImage(
-			uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits numSamples, vk::Format format, vk::ImageTiling tiling,
-			vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::UniqueImage& image, vk::UniqueDeviceMemory& imageMemory) {
+	void recordCommandBuffer(size_t frame, uint32_t imageIndex) {
+		CpuScope scope("recordCommandBuffer");
+		device->resetCommandPool(frameCommandPools[frame].get(), vk::CommandPoolResetFlags());
+		for (auto& workerPool : workerCommandPools[frame]) {
+			device->resetCommandPool(workerPool.pool.get(), vk::CommandPoolResetFlags());
+			workerPool.usedCommandBuffers = 0;
+		}
 
-		vk::ImageCreateInfo imageInfo = {};
-		imageInfo.imageType = vk::ImageType::e2D;
-		imageInfo.extent.width = width;
-		imageInfo.extent.height = height;
-		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
-		imageInfo.arrayLayers = 1;
-		imageInfo.format = format;
-		imageInfo.tiling = tiling;
-		imageInfo.initialLayout = vk::ImageLayout::eUndefined;
-		imageInfo.usage = usage;
-		imageInfo.sharingMode = vk::SharingMode::eExclusive;
-		imageInfo.samples = numSamples;
-		imageInfo.mipLevels = mipLevels;
+		vk::CommandBuffer commandBuffer = commandBuffers[frame].get();
+		vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr);
+		vk::DeviceGroupCommandBufferBeginInfo deviceGroupBeginInfo(frameDeviceMask);
+		if (alternateFrameDevices > 1)
+			beginInfo.pNext = &deviceGroupBeginInfo;
+		commandBuffer.begin(beginInfo);
+
+		if (timestampQueries)
+			commandBuffer.resetQueryPool(timestampQueryPools[frame].get(), 0, GPU_SCOPE_COUNT * 2);
+		if (statisticsQueries) {
+			commandBuffer.resetQueryPool(statisticsQueryPools[frame].get(), 0, 1);
+			commandBuffer.beginQuery(statisticsQueryPools[frame].get(), 0, vk::QueryControlFlags());
+		}
+		if (profiling)
+			frameQueriesWritten[frame] = true;
+
+		beginGpuScope(commandBuffer, frame, GpuScope::eFrame);
+
+		beginGpuScope(commandBuffer, frame, GpuScope::eCulling);
+		if (gpuCulling)
+			recordCulling(commandBuffer, frame);
+		endGpuScope(commandBuffer, frame, GpuScope::eCulling);
+
+		std::array<vk::ClearValue, 2> clearValues;
+		clearValues[0].color = vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f});
+		clearValues[1].depthStencil = {1.0f, 0};
+
+		beginGpuScope(commandBuffer, frame, GpuScope::eRenderPass);
+		if (dynamicRendering) {
+			beginDynamicRendering(commandBuffer, imageIndex, clearValues);
+		} else {
+			vk::RenderPassBeginInfo renderPassBeginInfo(
+				renderPass.get(), swapchainFramebuffers[imageIndex].get(), vk::Rect2D({0, 0}, swapchainExtent),
+				static_cast<uint32_t>(clearValues.size()), clearValues.data()
+			);
+			commandBuffer.beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+		}
+
+		//split the draws into a few jobs per worker so uneven submeshes still balance out,
+		//culled draws are a single indirect call so there is nothing to split
+		size_t drawGroups = gpuCulling ? 1 : getLodSubmeshCount();
+		size_t jobCount = std::min<size_t>(drawGroups, workers->size() * 4);
+		size_t submeshesPerJob = jobCount > 0 ? (drawGroups + jobCount - 1) / jobCount : 1;
+		jobCount = (drawGroups + submeshesPerJob - 1) / submeshesPerJob;
+		std::vector<vk::CommandBuffer> secondaryCommandBuffers(jobCount);
+
+		vk::CommandBufferInheritanceInfo inheritanceInfo(
+			renderPass.get(), 0, dynamicRendering ? vk::Framebuffer() : swapchainFramebuffers[imageIndex].get(), false, vk::QueryControlFlags(),
+			statisticsQueries ? getPipelineStatisticFlags() : vk::QueryPipelineStatisticFlags()
+		);
+
+#ifdef VK_KHR_dynamic_rendering
+		VkFormat colorFormat = static_cast<VkFormat>(swapchainImageFormat);
+		VkCommandBufferInheritanceRenderingInfoKHR inheritanceRenderingInfo = {};
+		inheritanceRenderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+		inheritanceRenderingInfo.colorAttachmentCount = 1;
+		inheritanceRenderingInfo.pColorAttachmentFormats = &colorFormat;
+		inheritanceRenderingInfo.depthAttachmentFormat = static_cast<VkFormat>(depthFormat);
+		inheritanceRenderingInfo.rasterizationSamples = static_cast<VkSampleCountFlagBits>(msaaSamples);
+		if (dynamicRendering)
+			inheritanceInfo.pNext = &inheritanceRenderingInfo;
+#endif
 
-		image = device->createImageUnique(imageInfo);
+		workers->parallelFor(static_cast<uint32_t>(jobCount), [&](uint32_t job, uint32_t workerIndex) {
+			CpuScope scope("recordDraws");
+			vk::CommandBuffer secondary = getSecondaryCommandBuffer(frame, workerIndex);
+			secondary.begin(
+				vk::CommandBufferBeginInfo(
+					vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue, &inheritanceInfo
+				)
+			);
 
-		vk::MemoryRequirements memRequirements = device->getImageMemoryRequirements(image.get());
+			size_t firstSubmesh = job * submeshesPerJob;
+			recordDraws(secondary, frame, firstSubmesh, std::min(submeshesPerJob, drawGroups - firstSubmesh));
+
+			secondary.end();
+			secondaryCommandBuffers[job] = secondary;
+		});
+
+		//executed in job order, so the result doesn't depend on how the jobs were scheduled
+		if (!secondaryCommandBuffers.empty())
+			commandBuffer.executeCommands(secondaryCommandBuffers);
 
-		vk::MemoryAllocateInfo allocInfo = {};
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+		if (dynamicRendering)
+			endDynamicRendering(commandBuffer, imageIndex);
+		else
+			commandBuffer.endRenderPass();
+		endGpuScope(commandBuffer, frame, GpuScope::eRenderPass);
 
-		imageMemory = device->allocateMemoryUnique(allocInfo);
+		if (!readbackBuffers.empty())
+			recordReadback(commandBuffer, imageIndex, frameNumber + 1);
 
-		device->bindImageMemory(image.get(), imageMemory.get(), 0);
+		endGpuScope(commandBuffer, frame, GpuScope::eFrame);
+		if (statisticsQueries)
+			commandBuffer.endQuery(statisticsQueryPools[frame].get(), 0);
+
+		commandBuffer.end();
 	}
 
-	void transitionImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels) {
-		std::vector<vk::UniqueCommandBuffer> commandBuffers = beginSingleTimeCommands();
+	//does what the render pass's initial layouts and external dependency did: the attachments start out undefined,
+	//the color waits for the acquire semaphore's stage and the depth for the previous frame's depth writes
+	void beginDynamicRendering(vk::CommandBuffer commandBuffer, uint32_t imageIndex, const std::array<vk::ClearValue, 2>& clearValues) {
+#ifdef VK_KHR_dynamic_rendering
+		VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+		if (hasStencilComponent(depthFormat))
+			depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+		std::vector<VkImageMemoryBarrier2KHR> barriers;
+		barriers.push_back(makeImageBarrier2(
+			swapchainImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, 0, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+		));
+		if (resolvesColor()) {
+			barriers.push_back(makeImageBarrier2(
+				colorImage.get(), VK_IMAGE_ASPECT_COLOR_BIT,
+				VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, 0, VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+			));
+		}
+		barriers.push_back(makeImageBarrier2(
+			depthImage.get(), depthAspect,
+			VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+		));
+		pipelineBarrier2(commandBuffer, barriers);
+
+		//with msaa the samples are resolved into the swapchain image and never stored, like the render pass does
+		VkRenderingAttachmentInfoKHR colorAttachment = {};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		colorAttachment.imageView = resolvesColor() ? colorImageView.get() : swapchainImageViews[imageIndex].get();
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = resolvesColor() ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.clearValue = clearValues[0];
+		if (resolvesColor()) {
+			colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT_KHR;
+			colorAttachment.resolveImageView = swapchainImageViews[imageIndex].get();
+			colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
 
-		vk::ImageMemoryBarrier barrier = {};
+		VkRenderingAttachmentInfoKHR depthAttachment = {};
+		depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		depthAttachment.imageView = depthImageView.get();
+		depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.clearValue = clearValues[1];
+
+		VkRenderingInfoKHR renderingInfo = {};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+		renderingInfo.renderArea = vk::Rect2D({0, 0}, swapchainExtent);
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+		renderingInfo.pDepthAttachment = &depthAttachment;
+
+		cmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+#endif
+	}
+
+	//hands the image on to the presentation engine, or to the transfer that reads an offscreen frame back
+	void endDynamicRendering(vk::CommandBuffer commandBuffer, uint32_t imageIndex) {
+#ifdef VK_KHR_dynamic_rendering
+		cmdEndRenderingKHR(commandBuffer);
+
+		std::vector<VkImageMemoryBarrier2KHR> barriers = {
+			options.offscreen ?
+				makeImageBarrier2(
+					swapchainImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+					VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+					VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+				) :
+				makeImageBarrier2(
+					swapchainImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+					VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+					VK_PIPELINE_STAGE_2_NONE_KHR, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+				)
+		};
+		pipelineBarrier2(commandBuffer, barriers);
+#endif
+	}
+
+#ifdef VK_KHR_dynamic_rendering
+	static VkImageMemoryBarrier2KHR makeImageBarrier2(
+			vk::Image image, VkImageAspectFlags aspect,
+			VkPipelineStageFlags2KHR srcStage, VkAccessFlags2KHR srcAccess, VkImageLayout oldLayout,
+			VkPipelineStageFlags2KHR dstStage, VkAccessFlags2KHR dstAccess, VkImageLayout newLayout) {
+		VkImageMemoryBarrier2KHR barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+		barrier.srcStageMask = srcStage;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstStageMask = dstStage;
+		barrier.dstAccessMask = dstAccess;
 		barrier.oldLayout = oldLayout;
 		barrier.newLayout = newLayout;
 		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		barrier.image = image;
-		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-		barrier.subresourceRange.baseMipLevel = 0;
-		barrier.subresourceRange.levelCount = mipLevels;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
+		barrier.subresourceRange = {aspect, 0, 1, 0, 1};
+		return barrier;
+	}
 
-		vk::PipelineStageFlags sourceStage;
-		vk::PipelineStageFlags destinationStage;
+	void pipelineBarrier2(vk::CommandBuffer commandBuffer, const std::vector<VkImageMemoryBarrier2KHR>& barriers) {
+		VkDependencyInfoKHR dependencyInfo = {};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+		dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+		dependencyInfo.pImageMemoryBarriers = barriers.data();
+		cmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+	}
+#endif
 
-		if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal) {
-			barrier.srcAccessMask = vk::AccessFlags();
-			barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+	void createReadbackBuffers() {
+		if (options.readbackDirectory.empty())
+			return;
 
-			sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
-			destinationStage = vk::PipelineStageFlagBits::eTransfer;
-		} else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal) {
-			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-			barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		std::error_code ec;
+		std::filesystem::create_directories(options.readbackDirectory, ec);
+		if (ec)
+			throw std::runtime_error("failed to create " + options.readbackDirectory + "!");
+
+		//the cpu reads every byte back, so cached memory is worth having where the device offers it
+		vk::DeviceSize size = static_cast<vk::DeviceSize>(swapchainExtent.width) * swapchainExtent.height * 4;
+		readbackBuffers.resize(framesInFlight * READBACK_BUFFERS_PER_FRAME);
+		for (auto& readback : readbackBuffers) {
+			readback.buffer = device->createBufferUnique(
+				vk::BufferCreateInfo(vk::BufferCreateFlags(), size, vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive)
+			);
 
-			sourceStage = vk::PipelineStageFlagBits::eTransfer;
-			destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
-		} else {
-			throw std::invalid_argument("unsupported layout transition!");
+			vk::MemoryRequirements memRequirements = device->getBufferMemoryRequirements(readback.buffer.get());
+			uint32_t memoryType = findMemoryType(
+				memRequirements.memoryTypeBits,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, vk::MemoryPropertyFlagBits::eHostCached
+			);
+			readback.memory = allocator.allocate(memRequirements, memoryType, MemoryPoolKind::eBuffer);
+			device->bindBufferMemory(readback.buffer.get(), readback.memory->memory, readback.memory->offset);
 		}
-
-		commandBuffers[0]->pipelineBarrier(sourceStage, destinationStage, vk::DependencyFlags(), nullptr, nullptr, barrier);
-
-		endSingleTimeCommands(commandBuffers);
 	}
 
-	void copyBufferToImage(vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height) {
-		std::vector<vk::UniqueCommandBuffer> commandBuffers = beginSingleTimeCommands();
-
-		vk::BufferImageCopy region = {};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-		region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = 1;
-		region.imageOffset = { 0, 0, 0 };
-		region.imageExtent = {width, height, 1};
+	ReadbackBuffer& getReadbackBuffer(uint64_t number) {
+		return readbackBuffers[number % readbackBuffers.size()];
+	}
 
-		commandBuffers[0]->copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal, region);
+	//the buffer was last used READBACK_BUFFERS_PER_FRAME rounds of frames ago, so only a slow encode is left to wait for
+	void prepareReadback(uint64_t number) {
+		if (readbackBuffers.empty())
+			return;
 
-		endSingleTimeCommands(commandBuffers);
+		ReadbackBuffer& readback = getReadbackBuffer(number);
+		if (readback.write.valid()) {
+			CpuScope scope("waitForReadback");
+			readback.write.get();
+		}
 	}
 
-	void loadModel() {
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		std::string warn, err;
+	//the image was left in transfer src layout when rendering ended, only its writes have to be waited for
+	void recordReadback(vk::CommandBuffer commandBuffer, uint32_t imageIndex, uint64_t number) {
+		ReadbackBuffer& readback = getReadbackBuffer(number);
 
-		if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str()))
-			throw std::runtime_error(warn + err);
+		vk::ImageMemoryBarrier imageBarrier(
+			vk::AccessFlagBits::eColorAttachmentWrite, vk::AccessFlagBits::eTransferRead,
+			vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eTransferSrcOptimal,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			swapchainImages[imageIndex], vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)
+		);
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eTransfer,
+			vk::DependencyFlags(), nullptr, nullptr, imageBarrier
+		);
 
-		std::unordered_map<Vertex, uint32_t> uniqueVertices = {};
+		vk::BufferImageCopy region(
+			0, 0, 0,
+			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+			vk::Offset3D(0, 0, 0), vk::Extent3D(swapchainExtent.width, swapchainExtent.height, 1)
+		);
+		commandBuffer.copyImageToBuffer(swapchainImages[imageIndex], vk::ImageLayout::eTransferSrcOptimal, readback.buffer.get(), region);
+
+		vk::BufferMemoryBarrier bufferBarrier(
+			vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			readback.buffer.get(), 0, VK_WHOLE_SIZE
+		);
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+			vk::DependencyFlags(), nullptr, bufferBarrier, nullptr
+		);
 
-		for (const auto& shape : shapes) {
-			for (const auto& index : shape.mesh.indices) {
-				Vertex vertex = {};
+		readback.frameNumber = number;
+	}
 
-				vertex.pos = {
-					attrib.vertices[3 * index.vertex_index + 0],
-					attrib.vertices[3 * index.vertex_index + 1],
-					attrib.vertices[3 * index.vertex_index + 2]
-				};
+	//hands every buffer whose frame is known to have finished to a worker, which encodes it while later frames render
+	void collectReadbacks(uint64_t completedNumber) {
+		for (auto& readback : readbackBuffers) {
+			if (readback.frameNumber == 0 || readback.frameNumber > completedNumber)
+				continue;
+
+			std::ostringstream name;
+			name << "frame_" << std::setw(6) << std::setfill('0') << readback.frameNumber - 1 << ".png";
+			std::string path = (std::filesystem::path(options.readbackDirectory) / name.str()).string();
+			const void* pixels = readback.memory->mapped;
+			int width = static_cast<int>(swapchainExtent.width);
+			int height = static_cast<int>(swapchainExtent.height);
+
+			readback.write = workers->submit([path, pixels, width, height](uint32_t) {
+				CpuScope scope("writeReadback");
+				if (!stbi_write_png(path.c_str(), width, height, 4, pixels, width * 4))
+					throw std::runtime_error("failed to write " + path + "!");
+			});
+			readback.frameNumber = 0;
+		}
+	}
 
-				vertex.texCoord = {
-					attrib.texcoords[2 * index.texcoord_index + 0],
-					1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-				};
+	void createSyncObjects() {
+		imageAvailableSemaphores.resize(framesInFlight);
+		renderFinishedSemaphores.resize(framesInFlight);
+		inFlightFences.resize(framesInFlight);
+		imagesInFlight.assign(swapchainImages.size(), 0);
+		frameSlotNumbers.assign(framesInFlight, 0);
 
-				vertex.color = { 1.0f, 1.0f, 1.0f };
+		for (size_t i = 0; i < framesInFlight; ++i) {
+			imageAvailableSemaphores[i] = device->createSemaphoreUnique(vk::SemaphoreCreateInfo(vk::SemaphoreCreateFlags()));
+			renderFinishedSemaphores[i] = device->createSemaphoreUnique(vk::SemaphoreCreateInfo(vk::SemaphoreCreateFlags()));
+			inFlightFences[i] = device->createFenceUnique(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+		}
 
-				if(uniqueVertices.count(vertex) == 0) {
-					uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-					vertices.push_back(vertex);
-				}
+#ifdef VK_KHR_timeline_semaphore
+		if (waitSemaphoresKHR) {
+			VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+			typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			typeInfo.initialValue = 0;
 
-				indices.push_back(uniqueVertices[vertex]);
-			}
+			vk::SemaphoreCreateInfo semaphoreInfo;
+			semaphoreInfo.pNext = &typeInfo;
+			frameTimeline = device->createSemaphoreUnique(semaphoreInfo);
 		}
+#endif
 	}
 
-	void createVertexBuffer() {
-		vk::DeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+	//blocks until the frame with this number has finished on the gpu, frames that were never submitted count as finished
+	void waitForFrame(uint64_t number) {
+		if (number == 0 || number <= completedFrameNumber)
+			return;
 
-		vk::UniqueBuffer stagingBuffer;
-		vk::UniqueDeviceMemory stagingBufferMemory;
-		createBuffer(
-			bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-			stagingBuffer, stagingBufferMemory
-		);
+		CpuScope scope("waitForFrame");
+
+#ifdef VK_KHR_timeline_semaphore
+		if (frameTimeline) {
+			VkSemaphore semaphore = frameTimeline.get();
+			VkSemaphoreWaitInfoKHR waitInfo = {};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &semaphore;
+			waitInfo.pValues = &number;
+			if (waitSemaphoresKHR(device.get(), &waitInfo, UINT64_MAX) != VK_SUCCESS)
+				throw std::runtime_error("failed to wait for frame timeline!");
+
+			//timeline values only ever go up, so everything before this frame is done too
+			completedFrameNumber = number;
+			return;
+		}
+#endif
 
-		void* data = device->mapMemory(stagingBufferMemory.get(), 0, bufferSize, vk::MemoryMapFlags());
-		memcpy(data, vertices.data(), (size_t)bufferSize);
-		device->unmapMemory(stagingBufferMemory.get());
+		//a slot that has moved on to a later frame was waited on before it was reused
+		size_t slot = (number - 1) % framesInFlight;
+		if (frameSlotNumbers[slot] == number)
+			device->waitForFences(1, &inFlightFences[slot].get(), true, UINT64_MAX);
+	}
 
-		createBuffer(
-			bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
-			vk::MemoryPropertyFlagBits::eDeviceLocal,
-			vertexBuffer, vertexBufferMemory
-		);
+	void waitForAllFrames() {
+#ifdef VK_KHR_timeline_semaphore
+		if (frameTimeline) {
+			waitForFrame(frameNumber);
+			return;
+		}
+#endif
 
-		copyBuffer(stagingBuffer.get(), vertexBuffer.get(), bufferSize);
+		std::vector<vk::Fence> fences;
+		for (const auto& fence : inFlightFences)
+			fences.push_back(fence.get());
+		device->waitForFences(fences, true, UINT64_MAX);
 	}
 
-	void createIndexBuffer() {
-		vk::DeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+	void updateUniformBuffer(size_t frame) {
+		CpuScope scope("updateUniformBuffer");
+		static auto startTime = std::chrono::high_resolution_clock::now();
 
-		vk::UniqueBuffer stagingBuffer;
-		vk::UniqueDeviceMemory stagingBufferMemory;
-		createBuffer(
-			bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-			stagingBuffer, stagingBufferMemory
-		);
+		auto currentTime = std::chrono::high_resolution_clock::now();
+		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
-		void* data = device->mapMemory(stagingBufferMemory.get(), 0, bufferSize, vk::MemoryMapFlags());
-		memcpy(data, indices.data(), (size_t)bufferSize);
-		device->unmapMemory(stagingBufferMemory.get());
+		//benchmarks animate by frame number so that every run renders exactly the same frames
+		if (options.benchmarkFrames > 0)
+			time = frameNumber / 60.0f;
 
-		createBuffer(
-			bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
-			vk::MemoryPropertyFlagBits::eDeviceLocal,
-			indexBuffer, indexBufferMemory
-		);
+		//backs off far enough to keep the whole instance grid in view, a single instance gets the original camera
+		float sceneScale = getInstanceGridSize() > 1 ? getInstanceGridSize() * getInstanceSpacing() * 0.5f : 1.0f;
+		glm::vec3 eye = glm::vec3(2.0f, 2.0f, 2.0f) * sceneScale;
+		glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		glm::mat4 proj = glm::perspective(glm::radians(45.0f), swapchainExtent.width / (float)swapchainExtent.height, 0.1f, 10.0f * sceneScale);
+		proj[1][1] *= -1;
 
-		copyBuffer(stagingBuffer.get(), indexBuffer.get(), bufferSize);
+		UniformBufferObject ubo = {};
+		ubo.viewProj = proj * view;
+		ubo.positionScale = glm::vec4(positionScale, 0.0f);
+		ubo.positionOffset = glm::vec4(positionOffset, 0.0f);
+		ubo.texCoordTransform = texCoordTransform;
+		frustumPlanes = extractFrustumPlanes(ubo.viewProj);
+		//where the mesh's bounding sphere has shrunk to LOD_FULL_DETAIL_RADIUS pixels on screen
+		lodDistance = meshRadius * std::abs(proj[1][1]) * swapchainExtent.height * 0.5f / LOD_FULL_DETAIL_RADIUS;
+		//how many pixels across the closest instance can be, from the nearest corner of the grid
+		float gridRadius = instanceCount > 1 ? (getInstanceGridSize() - 1) * getInstanceSpacing() * 0.5f * std::sqrt(2.0f) : 0.0f;
+		float nearest = std::max(glm::length(eye) - gridRadius - meshRadius, 0.1f);
+		textureDemandPixels = meshRadius * std::abs(proj[1][1]) * swapchainExtent.height / nearest;
+
+		memcpy(static_cast<uint8_t*>(uniformBufferMemory->mapped) + frame * uniformBufferStride, &ubo, sizeof(ubo));
+
+		updateInstanceBuffer(frame, time);
 	}
 
-	void createUniformBuffers() {
-		vk::DeviceSize bufferSize = sizeof(UniformBufferObject);
-
-		uniformBuffers.resize(swapchainImages.size());
-		uniformBuffersMemory.resize(swapchainImages.size());
-
-		for (size_t i = 0; i < swapchainImages.size(); ++i) {
-			createBuffer(
-				bufferSize, vk::BufferUsageFlagBits::eUniformBuffer,
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-				uniformBuffers[i], uniformBuffersMemory[i]
-			);
-		}
+	uint32_t getInstanceGridSize() {
+		return static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(instanceCount))));
 	}
 
-	void createDescriptorPool() {
-		std::array<vk::DescriptorPoolSize, 2> poolSizes = {};
-		poolSizes[0].type = vk::DescriptorType::eUniformBuffer;
-		poolSizes[0].descriptorCount = static_cast<uint32_t>(swapchainImages.size());
-		poolSizes[1].type = vk::DescriptorType::eCombinedImageSampler;
-		poolSizes[1].descriptorCount = static_cast<uint32_t>(swapchainImages.size());
-
-		vk::DescriptorPoolCreateInfo poolInfo = {};
-		poolInfo.poolSizeCount = poolSizes.size();
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = static_cast<uint32_t>(swapchainImages.size());
+	float getInstanceSpacing() {
+		return meshRadius * 2.5f;
+	}
 
-		descriptorPool = device->createDescriptorPoolUnique(poolInfo);
+	//instances sit on a square grid in the ground plane, each turning slowly from its own starting angle.
+	//the model's own spin is folded into the same rotation, so the shader needs just this one matrix per vertex
+	void updateInstanceBuffer(size_t frame, float time) {
+		glm::mat4* mappedInstances = reinterpret_cast<glm::mat4*>(static_cast<uint8_t*>(instanceBufferMemory->mapped) + frame * instanceSliceStride);
+		//the culling pass buckets the instances by lod itself, otherwise they are sorted into lodFirstInstance's ranges below
+		bool sortByLod = lodCount > 1 && !gpuCulling;
+		glm::mat4* instances = sortByLod ? unsortedInstances.data() : mappedInstances;
+
+		writeInstanceTransforms(instances, time);
+		if (sortByLod)
+			sortInstancesByLod(instances, mappedInstances);
 	}
 
-	void createDescriptorSets() {
-		std::vector<vk::DescriptorSetLayout> layouts(swapchainImages.size(), descriptorSetLayout.get());
+	void writeInstanceTransforms(glm::mat4* instances, float time) {
+		uint32_t gridSize = getInstanceGridSize();
+		float spacing = getInstanceSpacing();
+		float gridOrigin = (gridSize - 1) * spacing * -0.5f;
 
-		vk::DescriptorSetAllocateInfo allocInfo = {};
-		allocInfo.descriptorPool = descriptorPool.get();
-		allocInfo.descriptorSetCount = static_cast<uint32_t>(swapchainImages.size());
-		allocInfo.pSetLayouts = layouts.data();
+		float modelAngle = time * glm::radians(90.0f);
 
-		descriptorSets = device->allocateDescriptorSets(allocInfo);
+		//a single instance stays put so the default view looks exactly as before
+		if (instanceCount == 1) {
+			instances[0] = glm::rotate(glm::mat4(1.0f), modelAngle, glm::vec3(0.0f, 0.0f, 1.0f));
+			return;
+		}
 
-		for (size_t i = 0; i < swapchainImages.size(); ++i) {
-			vk::DescriptorBufferInfo bufferInfo = {};
-			bufferInfo.buffer = uniformBuffers[i].get();
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(UniformBufferObject);
+		const uint32_t INSTANCES_PER_JOB = 4096;
+		uint32_t jobCount = (instanceCount + INSTANCES_PER_JOB - 1) / INSTANCES_PER_JOB;
 
-			vk::DescriptorImageInfo imageInfo = {};
-			imageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-			imageInfo.imageView = textureImageView.get();
-			imageInfo.sampler = textureSampler.get();
+		auto writeInstances = [&](uint32_t job, uint32_t) {
+			uint32_t end = std::min(instanceCount, (job + 1) * INSTANCES_PER_JOB);
+			for (uint32_t i = job * INSTANCES_PER_JOB; i < end; ++i) {
+				glm::vec3 position(gridOrigin + (i % gridSize) * spacing, gridOrigin + (i / gridSize) * spacing, 0.0f);
+				instances[i] = glm::rotate(glm::translate(glm::mat4(1.0f), position), i * 0.618f + time * 0.1f + modelAngle, glm::vec3(0.0f, 0.0f, 1.0f));
+			}
+		};
 
-			std::array<vk::WriteDescriptorSet, 2> descriptorWrites = {};
+		if (jobCount > 1)
+			workers->parallelFor(jobCount, writeInstances);
+		else
+			writeInstances(0, 0);
+	}
 
-			descriptorWrites[0].dstSet = descriptorSets[i];
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = vk::DescriptorType::eUniformBuffer;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].pBufferInfo = &bufferInfo;
+	//counting sort, instances keep their relative order within a lod
+	void sortInstancesByLod(const glm::mat4* instances, glm::mat4* destination) {
+		std::fill(lodFirstInstance.begin(), lodFirstInstance.end(), 0);
+		for (uint32_t i = 0; i < instanceCount; ++i) {
+			glm::vec3 center(instances[i][3]);
+			float distance = glm::dot(glm::vec3(frustumPlanes[4]), center) + frustumPlanes[4].w;
+			instanceLods[i] = selectLod(distance, lodDistance, lodCount);
+			++lodFirstInstance[instanceLods[i] + 1];
+		}
 
-			descriptorWrites[1].dstSet = descriptorSets[i];
-			descriptorWrites[1].dstBinding = 1;
-			descriptorWrites[1].dstArrayElement = 0;
-			descriptorWrites[1].descriptorType = vk::DescriptorType::eCombinedImageSampler;
-			descriptorWrites[1].descriptorCount = 1;
-			descriptorWrites[1].pImageInfo = &imageInfo;
+		for (uint32_t lod = 1; lod <= lodCount; ++lod)
+			lodFirstInstance[lod] += lodFirstInstance[lod - 1];
 
-			device->updateDescriptorSets(descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
-		}
+		std::vector<uint32_t> nextInstance(lodFirstInstance.begin(), lodFirstInstance.end() - 1);
+		for (uint32_t i = 0; i < instanceCount; ++i)
+			destination[nextInstance[instanceLods[i]]++] = instances[i];
 	}
 
-	void createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::UniqueBuffer& buffer, vk::UniqueDeviceMemory& bufferMemory) {
-		vk::BufferCreateInfo bufferCreateInfo(
-			vk::BufferCreateFlags(), size,
-			usage, vk::SharingMode::eExclusive
-		);
+	void drawFrame() {
+		//sleeping right before the frame starts rather than after it is presented keeps what it shows as fresh as possible
+		if (frameInterval > std::chrono::steady_clock::duration::zero()) {
+			std::this_thread::sleep_until(nextFrameDeadline);
+			nextFrameDeadline = std::max(nextFrameDeadline, std::chrono::steady_clock::now()) + frameInterval;
+		}
 
-		buffer = device->createBufferUnique(bufferCreateInfo);
+		CpuProfiler::setFrame(frameNumber);
+		CpuScope frameScope("drawFrame");
+
+		FrameProfile profile;
+		auto frameStart = std::chrono::high_resolution_clock::now();
+		profile.frameNumber = frameNumber;
+		profile.cpuFrameMs = std::chrono::duration<double, std::milli>(frameStart - lastFrameStart).count();
+		lastFrameStart = frameStart;
+
+		//the slot's resources are free once the frame that last used it is done, a lower latency limit waits on a more recent frame
+		uint64_t number = frameNumber + 1;
+		if (number > framesInFlight)
+			waitForFrame(number - framesInFlight);
+		if (number > maxLatency && maxLatency < framesInFlight)
+			waitForFrame(number - maxLatency);
+		profile.fenceWaitMs = millisecondsSince(frameStart);
+
+		collectFrameProfile(currentFrame);
+		if (number > framesInFlight)
+			collectReadbacks(number - framesInFlight);
+		prepareReadback(number);
+
+		retireUploads(false);
+		updateTextureResidency();
+
+		if (retiredSwapchain && ++framesSinceSwapchainRetired > framesInFlight)
+			retiredSwapchain.reset();
+		if (!retiredPipelines.empty() && ++framesSincePipelinesRetired > framesInFlight)
+			retiredPipelines.clear();
+
+		uint32_t frameDevice = static_cast<uint32_t>(frameNumber % alternateFrameDevices);
+		frameDeviceMask = 1u << frameDevice;
+
+		vk::ResultValue<uint32_t> result(vk::Result::eSuccess, 0);
+		auto acquireStart = std::chrono::high_resolution_clock::now();
+		if (!options.offscreen) {
+			try {
+				CpuScope scope("acquireNextImageKHR");
+				if (alternateFrameDevices > 1) {
+					result = device->acquireNextImage2KHR(
+						vk::AcquireNextImageInfoKHR(swapchain.get(), UINT64_MAX, imageAvailableSemaphores[currentFrame].get(), nullptr, frameDeviceMask)
+					);
+				} else {
+					result = device->acquireNextImageKHR(swapchain.get(), (uint64_t)UINT64_MAX, imageAvailableSemaphores[currentFrame].get(), nullptr);
+				}
+			} catch (const vk::OutOfDateKHRError&) {
+				recreateSwapchain();
+				return;
+			}
+			profile.acquireMs = millisecondsSince(acquireStart);
 
-		vk::MemoryRequirements memRequirements = device->getBufferMemoryRequirements(buffer.get());
+			waitForFrame(imagesInFlight[result.value]);
+			imagesInFlight[result.value] = number;
+		} else {
+			//the slot's image was last used by the frame waited on above
+			result.value = static_cast<uint32_t>(currentFrame);
+		}
 
-		bufferMemory = device->allocateMemoryUnique(
-			vk::MemoryAllocateInfo(
-				memRequirements.size,
-				findMemoryType(memRequirements.memoryTypeBits, properties)
-			)
-		);
+		updateUniformBuffer(currentFrame);
+		recordCommandBuffer(currentFrame, result.value);
 
-		device->bindBufferMemory(buffer.get(), bufferMemory.get(), 0);
-	}
+		//offscreen frames have nothing to wait for and nobody to signal
+		uint32_t semaphoreCount = options.offscreen ? 0 : 1;
+		vk::PipelineStageFlags waitStages = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
 
-	std::vector<vk::UniqueCommandBuffer> beginSingleTimeCommands() {
-		std::vector<vk::UniqueCommandBuffer> commandBuffers = device->allocateCommandBuffersUnique(
-			vk::CommandBufferAllocateInfo(
-				commandPool.get(), vk::CommandBufferLevel::ePrimary, 1
-			)
+		vk::SubmitInfo submitInfo(
+			semaphoreCount, &imageAvailableSemaphores[currentFrame].get(), &waitStages,
+			(uint32_t) 1, &(commandBuffers[currentFrame].get()),
+			semaphoreCount, &renderFinishedSemaphores[currentFrame].get()
 		);
+		vk::Fence fence = inFlightFences[currentFrame].get();
+
+#ifdef VK_KHR_timeline_semaphore
+		std::array<vk::Semaphore, 2> signalSemaphores = {renderFinishedSemaphores[currentFrame].get(), frameTimeline.get()};
+		std::array<uint64_t, 2> signalValues = {0, number};
+		VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+		if (frameTimeline) {
+			//binary semaphores ignore their value, the timeline one is always signalled last
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineInfo.signalSemaphoreValueCount = semaphoreCount + 1;
+			timelineInfo.pSignalSemaphoreValues = signalValues.data() + 1 - semaphoreCount;
+			submitInfo.signalSemaphoreCount = semaphoreCount + 1;
+			submitInfo.pSignalSemaphores = signalSemaphores.data() + 1 - semaphoreCount;
+			submitInfo.pNext = &timelineInfo;
+			fence = nullptr;
+		}
+#endif
 
-		commandBuffers[0]->begin(
-			vk::CommandBufferBeginInfo(
-				vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr
-			)
+		//the semaphores are waited on and signalled by the device that runs the frame
+		std::array<uint32_t, 2> semaphoreDeviceIndices = {frameDevice, frameDevice};
+		vk::DeviceGroupSubmitInfo deviceGroupSubmitInfo(
+			submitInfo.waitSemaphoreCount, semaphoreDeviceIndices.data(),
+			1, &frameDeviceMask,
+			submitInfo.signalSemaphoreCount, semaphoreDeviceIndices.data()
 		);
+		if (alternateFrameDevices > 1) {
+			deviceGroupSubmitInfo.pNext = submitInfo.pNext;
+			submitInfo.pNext = &deviceGroupSubmitInfo;
+		}
 
-		return commandBuffers;
-	}
+		if (fence)
+			device->resetFences(1, &fence);
+		insertFrameLabel(graphicsQueue, frameNumber);
+		{
+			CpuScope scope("submit");
+			graphicsQueue.submit(submitInfo, fence);
+		}
+		frameSlotNumbers[currentFrame] = number;
 
-	void endSingleTimeCommands(std::vector<vk::UniqueCommandBuffer>& commandBuffers) {
-		commandBuffers[0]->end();
+		vk::Result presentResult = vk::Result::eSuccess;
+		auto presentStart = std::chrono::high_resolution_clock::now();
+		if (!options.offscreen) {
+			vk::PresentInfoKHR presentInfo(
+				1, &renderFinishedSemaphores[currentFrame].get(),
+				1, &swapchain.get(),
+				&result.value, nullptr
+			);
 
-		vk::SubmitInfo submitInfo = {};
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers[0].get();
+			vk::PresentTimeGOOGLE presentTime(static_cast<uint32_t>(number), 0);
+			vk::PresentTimesInfoGOOGLE presentTimesInfo(1, &presentTime);
+			if (presentTiming == PresentTiming::eDisplayTiming)
+				presentInfo.pNext = &presentTimesInfo;
+#ifdef VK_KHR_present_wait
+			VkPresentIdKHR presentId = {};
+			presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+			presentId.swapchainCount = 1;
+			presentId.pPresentIds = &number;
+			if (presentTiming == PresentTiming::ePresentWait)
+				presentInfo.pNext = &presentId;
+#endif
+			vk::DeviceGroupPresentInfoKHR deviceGroupPresentInfo(1, &frameDeviceMask, vk::DeviceGroupPresentModeFlagBitsKHR::eLocal);
+			if (alternateFrameDevices > 1) {
+				deviceGroupPresentInfo.pNext = presentInfo.pNext;
+				presentInfo.pNext = &deviceGroupPresentInfo;
+			}
 
-		graphicsQueue.submit(submitInfo, nullptr);
-		graphicsQueue.waitIdle();
-	}
+			if (presentTiming != PresentTiming::eNone)
+				pendingPresents.emplace_back(number, std::chrono::steady_clock::now());
 
-	void copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size) {
-		std::vector<vk::UniqueCommandBuffer> commandBuffers = beginSingleTimeCommands();
+			try {
+				CpuScope scope("presentKHR");
+				presentResult = presentQueue.presentKHR(presentInfo);
+			} catch (const vk::OutOfDateKHRError&) {
+				presentResult = vk::Result::eErrorOutOfDateKHR;
+			}
+			profile.presentMs = millisecondsSince(presentStart);
 
-		vk::BufferCopy copyRegion(0, 0, size);
-		commandBuffers[0]->copyBuffer(srcBuffer, dstBuffer, copyRegion);
-		
-		endSingleTimeCommands(commandBuffers);
-	}
+			collectPresentTimings();
+		}
 
-	uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) {
-		vk::PhysicalDeviceMemoryProperties memProperties = physicalDevice.getMemoryProperties();
+		if (profiling)
+			frameProfiles[currentFrame] = profile;
 
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
-			if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-				return i;
-		}
+		++frameNumber;
+		currentFrame = (currentFrame + 1) % framesInFlight;
 
-		throw std::runtime_error("failed to find suitable memory type!");
+		if (presentResult != vk::Result::eSuccess || (framebufferResized && !options.offscreen)) {
+			framebufferResized = false;
+			recreateSwapchain();
+		}
 	}
 
-	void createCommandBuffers() {
-		commandBuffers.resize(swapchainFramebuffers.size());
-
-		commandBuffers = device->allocateCommandBuffersUnique(
-			vk::CommandBufferAllocateInfo(
-				commandPool.get(), vk::CommandBufferLevel::ePrimary, static_cast<uint32_t>(commandBuffers.size())
-			)
-		);
+	//only what depends on the swapchain images or extent is rebuilt, the pipeline uses dynamic viewport and scissor
+	void recreateSwapchain() {
+		//a minimised window has a zero sized surface, so wait until there is something to render to again
+		vk::Extent2D extent = chooseSwapExtent(physicalDevice.getSurfaceCapabilitiesKHR(surface.get()));
+		while ((extent.width == 0 || extent.height == 0) && !quitting) {
+			SDL_WaitEvent(&event);
+			if (event.type == SDL_QUIT)
+				quitting = true;
+			extent = chooseSwapExtent(physicalDevice.getSurfaceCapabilitiesKHR(surface.get()));
+		}
 
-		for (size_t i = 0; i < commandBuffers.size(); ++i) {
-			commandBuffers[i]->begin(
-				vk::CommandBufferBeginInfo(
-					vk::CommandBufferUsageFlags(), nullptr
-				)
-			);
+		if (quitting)
+			return;
 
-			std::array<vk::ClearValue, 2> clearValues;
-			clearValues[0].color = vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f});
-			clearValues[1].depthStencil = {1.0f, 0};
+		//the attachments and framebuffers below are only referenced by frames that are still in flight
+		waitForAllFrames();
 
-			vk::RenderPassBeginInfo renderPassBeginInfo(
-				renderPass.get(), swapchainFramebuffers[i].get(), vk::Rect2D({0, 0}, swapchainExtent),
-				static_cast<uint32_t>(clearValues.size()), clearValues.data()
-			);
-			commandBuffers[i]->beginRenderPass(&renderPassBeginInfo, vk::SubpassContents::eInline);
-			commandBuffers[i]->bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipelines[0].get());
-			commandBuffers[i]->bindVertexBuffers(0, {vertexBuffer.get()}, {0});
-			commandBuffers[i]->bindIndexBuffer(indexBuffer.get(), 0, vk::IndexType::eUint32);
-			commandBuffers[i]->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout.get(), 0, 1, &descriptorSets[i], 0, nullptr);
+		vk::Format oldFormat = swapchainImageFormat;
 
-			commandBuffers[i]->drawIndexed(static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+		createSwapchain();
+		createImageViews();
+		if (swapchainImageFormat != oldFormat) {
+			//a graphics pipeline from a reload in flight was built against the old render pass, but the one below uses the same sources
+			if (shaderReload.valid())
+				applyShaderReload();
 
-			commandBuffers[i]->endRenderPass();
-			commandBuffers[i]->end();
+			createRenderPass();
+			createGraphicsPipeline();
 		}
+		createColorResources();
+		createDepthResources();
+		createFramebuffers();
+
+		imagesInFlight.assign(swapchainImages.size(), 0);
 	}
 
-	void createSyncObjects() {
-		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-		imagesInFlight.resize(swapchainImages.size(), -1);
+	std::vector<char> loadShaderCode(const ShaderSource& shader) {
+		if (!hotReload)
+			return readFile(shader.prebuiltPath);
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-			imageAvailableSemaphores[i] = device->createSemaphoreUnique(vk::SemaphoreCreateInfo(vk::SemaphoreCreateFlags()));
-			renderFinishedSemaphores[i] = device->createSemaphoreUnique(vk::SemaphoreCreateInfo(vk::SemaphoreCreateFlags()));
-			inFlightFences[i] = device->createFenceUnique(vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+		try {
+			return compileShader(shader.sourcePath);
+		} catch (const std::runtime_error& error) {
+			std::cerr << error.what() << " using " << shader.prebuiltPath << std::endl;
+			return readFile(shader.prebuiltPath);
 		}
 	}
 
-	void updateUniformBuffer(uint32_t currentImage) {
-		static auto startTime = std::chrono::high_resolution_clock::now();
-
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+	//looks the source's hash up in the SPIR-V cache and only runs the compiler on a miss, safe to call from any thread
+	static std::vector<char> compileShader(const std::string& sourcePath) {
+		std::vector<char> source = readFile(sourcePath);
+		std::ostringstream hash;
+		hash << std::hex << hashBytes(reinterpret_cast<const uint8_t*>(source.data()), source.size());
+
+		std::filesystem::path cachePath = std::filesystem::path(SHADER_CACHE_DIRECTORY) /
+			(std::filesystem::path(sourcePath).filename().string() + "." + hash.str() + ".spv");
+		std::error_code ec;
+		if (std::filesystem::exists(cachePath, ec))
+			return readFile(cachePath.string());
+
+		//compiled under a temporary name so a failed or interrupted compile never leaves a bad cache entry
+		std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, ec);
+		std::string tempPath = cachePath.string() + ".tmp";
+		std::string command = SHADER_COMPILER + " \"" + sourcePath + "\" -o \"" + tempPath + "\"";
+		if (std::system(command.c_str()) != 0) {
+			std::filesystem::remove(tempPath, ec);
+			throw std::runtime_error("failed to compile " + sourcePath + "!");
+		}
 
-		UniformBufferObject ubo = {};
-		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.proj = glm::perspective(glm::radians(45.0f), swapchainExtent.width / (float)swapchainExtent.height, 0.1f, 10.0f);
-		ubo.proj[1][1] *= -1;
+		std::filesystem::rename(tempPath, cachePath, ec);
+		if (ec)
+			throw std::runtime_error("failed to write " + cachePath.string() + "!");
 
-		void* data = device->mapMemory(uniformBuffersMemory[currentImage].get(), 0, sizeof(ubo), vk::MemoryMapFlags());
-		memcpy(data, &ubo, sizeof(ubo));
-		device->unmapMemory(uniformBuffersMemory[currentImage].get());
+		return readFile(cachePath.string());
 	}
 
-	void drawFrame() {
-		device->waitForFences(1, &inFlightFences[currentFrame].get(), true, UINT64_MAX);
+	void watchShader(const ShaderSource& shader, bool culling) {
+		for (const auto& watched : watchedShaders) {
+			if (watched.path == shader.sourcePath)
+				return;
+		}
 
-		vk::ResultValue<uint32_t> result = device->acquireNextImageKHR(swapchain.get(), (uint64_t)UINT64_MAX, imageAvailableSemaphores[currentFrame].get(), nullptr);
+		std::error_code ec;
+		watchedShaders.push_back({shader.sourcePath, std::filesystem::last_write_time(shader.sourcePath, ec), culling});
+	}
 
-		if (result.result == vk::Result::eErrorOutOfDateKHR) {
-			recreateSwapchain();
+	//runs on the main thread between frames, the compiling and pipeline building happen on a worker
+	void pollShaderChanges() {
+		if (!hotReload || millisecondsSince(lastShaderPoll) < SHADER_POLL_INTERVAL_MS)
 			return;
-		}
-		
-		if (imagesInFlight[result.value] != -1) 
-			device->waitForFences(1, &inFlightFences[imagesInFlight[result.value]].get(), true, UINT64_MAX);
-		imagesInFlight[result.value] = currentFrame;
-		
-		vk::PipelineStageFlags waitStages = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-
-		device->resetFences(1, &inFlightFences[currentFrame].get());
+		lastShaderPoll = std::chrono::high_resolution_clock::now();
 
-		updateUniformBuffer(result.value);
+		if (shaderReload.valid()) {
+			if (shaderReload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				return;
+			applyShaderReload();
+		}
 
-		graphicsQueue.submit(
-			vk::SubmitInfo(
-				(uint32_t) 1, &imageAvailableSemaphores[currentFrame].get(), &waitStages,
-				(uint32_t) 1, &(commandBuffers[result.value].get()),
-				(uint32_t) 1, &renderFinishedSemaphores[currentFrame].get()
-			), inFlightFences[currentFrame].get()
-		);
+		bool graphicsChanged = false;
+		bool cullingChanged = false;
+		for (auto& watched : watchedShaders) {
+			std::error_code ec;
+			auto modifiedTime = std::filesystem::last_write_time(watched.path, ec);
+			if (ec || modifiedTime == watched.modifiedTime)
+				continue;
+
+			watched.modifiedTime = modifiedTime;
+			if (watched.culling)
+				cullingChanged = true;
+			else
+				graphicsChanged = true;
+		}
 
-		presentQueue.presentKHR(
-			vk::PresentInfoKHR(
-				1, &renderFinishedSemaphores[currentFrame].get(),
-				1, &swapchain.get(),
-				&result.value, nullptr
-			)
-		);
+		if (!graphicsChanged && !cullingChanged)
+			return;
 
-		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+		shaderReload = workers->submit([this, graphicsChanged, cullingChanged](uint32_t) {
+			ShaderReload reload;
+			if (graphicsChanged) {
+				reload.graphicsChanged = true;
+				reload.graphicsShaderCode.vertex = compileShader(VERTEX_SHADER.sourcePath);
+				reload.graphicsShaderCode.fragment = compileShader(getFragmentShader().sourcePath);
+				reload.graphicsPipelines = buildPipelineVariants(reload.graphicsShaderCode);
+			}
+			if (cullingChanged)
+				reload.cullPipeline = buildCullPipeline(compileShader(CULL_SHADER.sourcePath));
+			return reload;
+		});
 	}
 
-	void recreateSwapchain() {		
-		device->waitIdle();
-
-		createSwapchain();
-		createImageViews();
-		createRenderPass();
-		createGraphicsPipeline();
-		createColorResources();
-		createDepthResources();
-		createFramebuffers();
+	//a failed compile keeps the old pipelines, the next save of the source simply tries again
+	void applyShaderReload() {
+		ShaderReload reload;
+		try {
+			reload = shaderReload.get();
+		} catch (const std::exception& error) {
+			std::cerr << "shader reload failed: " << error.what() << std::endl;
+			return;
+		}
 
-		commandBuffers.clear();
-		uniformBuffers.clear();
-		uniformBuffersMemory.clear();
+		if (reload.graphicsChanged) {
+			for (auto& entry : graphicsPipelines)
+				retiredPipelines.push_back(std::move(entry.second));
+			graphicsPipelines = std::move(reload.graphicsPipelines);
+			graphicsShaderCode = std::move(reload.graphicsShaderCode);
+		}
+		if (reload.cullPipeline) {
+			retiredPipelines.push_back(std::move(cullPipeline));
+			cullPipeline = std::move(reload.cullPipeline);
+		}
 
-		createCommandPool();
-		createUniformBuffers();
-		createDescriptorPool();
-		createDescriptorSets();
-		createCommandBuffers();
+		framesSincePipelinesRetired = 0;
+		std::cout << "shaders reloaded" << std::endl;
 	}
 
 	vk::UniqueShaderModule createShaderModule(const std::vector<char>& code) {
@@ -1302,6 +6354,15 @@ private:
 	}
 
 	vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR>& availablePresentModes) {
+		//fifo is the only mode every surface has to support
+		if (options.presentMode) {
+			if (std::find(availablePresentModes.begin(), availablePresentModes.end(), *options.presentMode) != availablePresentModes.end())
+				return *options.presentMode;
+
+			std::cerr << "present mode " << vk::to_string(*options.presentMode) << " isn't supported, using fifo" << std::endl;
+			return vk::PresentModeKHR::eFifo;
+		}
+
 		for (const auto& availablePresentMode : availablePresentModes) {
 			if (availablePresentMode == vk::PresentModeKHR::eMailbox)
 				return availablePresentMode;
@@ -1340,8 +6401,8 @@ private:
 	bool isDeviceSuitable(vk::PhysicalDevice device) {
 		QueueFamilyIndices indices = findQueueFamilies(device);
 
-		bool swapchainAdequate = false;
-		if (checkDeviceExtensionSupport(device)) {
+		bool swapchainAdequate = options.offscreen;
+		if (!options.offscreen && checkDeviceExtensionSupport(device)) {
 			SwapchainSupportDetails swapchainSupport = querySwapchainSupport(device);
 			swapchainAdequate = !swapchainSupport.formats.empty() && !swapchainSupport.presentModes.empty();
 		}
@@ -1370,36 +6431,57 @@ private:
 
 		int i = 0;
 		for (const auto& queueFamily : queueFamilies) {
-			if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
-				indices.graphicsFamily = i;
+			if (!indices.isComplete()) {
+				if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics)
+					indices.graphicsFamily = i;
 
-			if (device.getSurfaceSupportKHR(i, surface.get()))
-				indices.presentFamily = i;
+				//without a surface the graphics queue stands in for the present queue, it is never presented from
+				if (surface ? device.getSurfaceSupportKHR(i, surface.get()) : bool(queueFamily.queueFlags & vk::QueueFlagBits::eGraphics))
+					indices.presentFamily = i;
+			}
 
-			if (indices.isComplete())
-				break;
+			bool transferOnly = (queueFamily.queueFlags & vk::QueueFlagBits::eTransfer) &&
+				!(queueFamily.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));
+			if (transferOnly && !indices.transferFamily.has_value())
+				indices.transferFamily = i;
 
 			i++;
 		}
 
+		if (!indices.transferFamily.has_value())
+			indices.transferFamily = indices.graphicsFamily;
+
 		return indices;
 	}
 
 	std::vector<const char*> getRequiredExtensions() {
-		unsigned int extensionCount;
-		if (!SDL_Vulkan_GetInstanceExtensions(window, &extensionCount, nullptr))
-			throw std::runtime_error("failed to get required SDL extension count!");
-
-		std::vector<const char*> extensions(extensionCount);
-		if (!SDL_Vulkan_GetInstanceExtensions(window, &extensionCount, extensions.data()))
-			throw std::runtime_error("failed to get required SDL extensions!");
+		std::vector<const char*> extensions;
+		if (window) {
+			unsigned int extensionCount;
+			if (!SDL_Vulkan_GetInstanceExtensions(window, &extensionCount, nullptr))
+				throw std::runtime_error("failed to get required SDL extension count!");
+
+			extensions.resize(extensionCount);
+			if (!SDL_Vulkan_GetInstanceExtensions(window, &extensionCount, extensions.data()))
+				throw std::runtime_error("failed to get required SDL extensions!");
+		}
 
-		if (enableValidationLayers)
+		//the labels work without validation too, as long as something like a capture layer provides the extension
+		debugLabels = !options.tracePath.empty() && (enableValidationLayers || instanceExtensionSupported(VK_EXT_DEBUG_UTILS_EXTENSION_NAME));
+		if (enableValidationLayers || debugLabels)
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
 		return extensions;
 	}
 
+	static bool instanceExtensionSupported(const char* name) {
+		for (const auto& extension : vk::enumerateInstanceExtensionProperties()) {
+			if (strcmp(extension.extensionName, name) == 0)
+				return true;
+		}
+		return false;
+	}
+
 	bool checkValidationLayerSupport() {
 		std::vector<vk::LayerProperties> availableLayers = vk::enumerateInstanceLayerProperties();
 
@@ -1450,9 +6532,8 @@ private:
 };
 
 int main(int argc, char* argv[]) {
-	HelloTriangleApplication app;
-
 	try {
+		HelloTriangleApplication app(parseCommandLine(argc, argv));
 		app.run();
 	} catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
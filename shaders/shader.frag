@@ -3,11 +3,18 @@
 
 layout(binding = 1) uniform sampler2D texSampler;
 
-layout(location = 0) in vec3 fragColor;
-layout(location = 1) in vec2 fragTexCoord;
+//PipelineVariant::textured and PipelineVariant::alphaTest, each combination is its own pipeline
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const bool ALPHA_TEST = false;
+
+layout(location = 0) in vec2 fragTexCoord;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-	outColor = texture(texSampler, fragTexCoord);
+	vec4 color = TEXTURED ? texture(texSampler, fragTexCoord) : vec4(0.8, 0.8, 0.8, 1.0);
+	if (ALPHA_TEST && color.a < 0.5)
+		discard;
+
+	outColor = color;
 }
\ No newline at end of file
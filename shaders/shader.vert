@@ -2,20 +2,21 @@
 #extension GL_ARB_separate_shader_objects : enable
 
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
+    mat4 viewProj;
+    vec4 positionScale;
+    vec4 positionOffset;
+    vec4 texCoordTransform;
 } ubo;
 
+//positions may be quantised to the mesh bounds, which positionScale and positionOffset undo
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
-layout(location = 2) in vec2 inTexCoord;
+layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) in mat4 inInstanceModel;
 
-layout(location = 0) out vec3 fragColor;
-layout(location = 1) out vec2 fragTexCoord;
+layout(location = 0) out vec2 fragTexCoord;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
-    fragColor = inColor;
-	fragTexCoord = inTexCoord;
+    vec3 position = inPosition * ubo.positionScale.xyz + ubo.positionOffset.xyz;
+    gl_Position = ubo.viewProj * (inInstanceModel * vec4(position, 1.0));
+	fragTexCoord = inTexCoord * ubo.texCoordTransform.xy + ubo.texCoordTransform.zw;
 }
\ No newline at end of file
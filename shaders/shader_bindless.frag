@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+
+//the same for a whole draw, so plain dynamic indexing is enough and no nonuniformEXT is needed
+layout(push_constant) uniform DrawParameters {
+	uint textureIndex;
+} draw;
+
+layout(set = 1, binding = 0) uniform sampler textureSampler;
+layout(set = 1, binding = 1) uniform texture2D textures[];
+
+//PipelineVariant::textured and PipelineVariant::alphaTest, each combination is its own pipeline
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const bool ALPHA_TEST = false;
+
+layout(location = 0) in vec2 fragTexCoord;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	vec4 color = TEXTURED ? texture(sampler2D(textures[draw.textureIndex], textureSampler), fragTexCoord) : vec4(0.8, 0.8, 0.8, 1.0);
+	if (ALPHA_TEST && color.a < 0.5)
+		discard;
+
+	outColor = color;
+}